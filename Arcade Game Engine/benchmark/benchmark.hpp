@@ -0,0 +1,83 @@
+//
+//  benchmark.hpp
+//  Benchmark
+//
+
+#pragma once
+
+#include <stdio.h>
+#include "core.hpp"
+
+/**
+ *  @return The time in seconds since some fixed point, for timing code.
+ */
+double now();
+
+/**
+ *  @return The number of bytes currently allocated with the new operator.
+ */
+size_t allocated_bytes();
+
+/**
+ *  The former narrowphase, as it was before the broadphases were added. It
+ *  rounds the bodies of the collider and of the obsticle and its descendants
+ *  to SDL rectangles, tests the rectangle enclosing the sweep, and then casts
+ *  rays from the four corners of the collider to find where it hits.
+ */
+void legacy_resolve_collisions(Entity & collider,
+                               Entity & obsticle,
+                               Vector2 & travel_distance,
+                               bool collision_response,
+                               vector<Entity*> & result);
+
+/**
+ *  Compares the broadphases on finding the bodies swept by moving bodies.
+ *
+ *  @return True if all broadphases found the same bodies as brute force.
+ */
+bool benchmark_broadphase_queries(int num_frames);
+
+/**
+ *  Compares maintaining the overlapping pairs with sweep and prune against
+ *  testing all pairs of bodies each frame.
+ *
+ *  @return True if sweep and prune found the same pairs as brute force.
+ */
+bool benchmark_broadphase_pairs(int num_frames);
+
+/**
+ *  Compares the swept AABB narrowphase, in doubles and in fixed point, against
+ *  the former narrowphase, which rounded the boxes to SDL rectangles and cast
+ *  rays from their corners.
+ *
+ *  @return True if the fixed-point sweep found the same hits as the double one.
+ */
+bool benchmark_narrowphase(int num_tests);
+
+/**
+ *  Compares testing an area against arrays of boxes with the batch overlap
+ *  kernel against testing the boxes one at a time.
+ *
+ *  @return True if the kernel found the same boxes as the scalar test.
+ */
+bool benchmark_overlaps(int num_tests);
+
+/**
+ *  Compares how far each integrator lets a fall drift at different frame
+ *  rates, and how long each takes to step a body.
+ */
+void benchmark_integration();
+
+/**
+ *  Steps scenes with 10 to 100000 static blocks and as many dynamic bodies
+ *  through a core, once with each broadphase, and reports the time per body
+ *  spent in the physics phase, the pairs tested and the contacts per frame,
+ *  the bodies asleep at the end, and the memory held by the scene. Brute force
+ *  and sweep and prune are only run on scenes of up to 20000 bodies. Scenes of
+ *  up to 2000 bodies are also stepped the way the former physics phase did,
+ *  as the baseline.
+ *
+ *  @param  report  The results will be written here as JSON.
+ *  @return True if the scene played out the same with every broadphase.
+ */
+bool benchmark_scaling(int num_frames, FILE * report);
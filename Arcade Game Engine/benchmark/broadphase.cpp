@@ -0,0 +1,300 @@
+//
+//  broadphase.cpp
+//  Benchmark
+//
+
+#include <random>
+#include <limits>
+#include <string>
+#include "benchmark.hpp"
+
+
+//
+// MARK: - Scene
+//
+
+const CollisionLayer PLATFORM_LAYER   = 1 << 0;
+const CollisionLayer PROJECTILE_LAYER = 1 << 1;
+
+/**
+ *  Defines a scene of bodies with very mixed sizes: a few large platforms
+ *  among many small projectiles, of which a quarter move every frame. The
+ *  projectiles collide with platforms but not with each other.
+ */
+struct Scene
+{
+  vector<AABB> bounds;
+  vector<CollisionFilter> filters;
+  vector<Vector2> velocities;
+  vector<int> dynamic_bodies;
+
+  Scene(int num_bodies, unsigned seed)
+  {
+    mt19937 generator(seed);
+    const double side = sqrt((double)num_bodies) * 64;
+    uniform_real_distribution<double> position(0, side);
+    uniform_real_distribution<double> unit(0, 1);
+    uniform_real_distribution<double> speed(-8, 8);
+
+    for (int i = 0; i < num_bodies; i++)
+    {
+      const Vector2 pos {position(generator), position(generator)};
+      const bool platform = unit(generator) < 0.1;
+      const Dimension2 dim = platform
+        ? Dimension2 {128 + 384*unit(generator), 16 + 16*unit(generator)}
+        : Dimension2 {4 + 12*unit(generator), 4 + 12*unit(generator)};
+      bounds.push_back({pos, pos + dim});
+      filters.push_back(platform
+        ? CollisionFilter {PLATFORM_LAYER, ALL_LAYERS}
+        : CollisionFilter {PROJECTILE_LAYER, PLATFORM_LAYER});
+      velocities.push_back({0, 0});
+
+      if (!platform && unit(generator) < 0.25)
+      {
+        velocities.back() = {speed(generator), speed(generator)};
+        dynamic_bodies.push_back(i);
+      }
+    }
+  }
+};
+
+
+//
+// MARK: - Broadphase benchmarks
+//
+
+// MARK: Helper functions
+
+/**
+ *  Queries areas reaching far beyond the scene, up to infinitely far, like
+ *  those of unbounded rays, after removing a body.
+ *
+ *  @return A sum over the bodies found and their number, which does not
+ *          depend on the order they were reported in.
+ */
+unsigned long long _queryBeyondScene(Broadphase & broadphase,
+                                      BroadphaseProxy removed)
+{
+  const double infinity = numeric_limits<double>::infinity();
+  const AABB areas[]
+  {
+    {{-1e12, -1e12}, {1e12, 1e12}},
+    {{-infinity, -infinity}, {infinity, infinity}},
+    {{0, -infinity}, {64, infinity}}
+  };
+  broadphase.remove(removed);
+
+  vector<void*> bodies;
+  unsigned long long checksum = 0;
+  for (size_t i = 0; i < 3; i++)
+  {
+    bodies.clear();
+    broadphase.query(areas[i], ALL_LAYERS, bodies);
+    checksum += bodies.size();
+    for (auto body : bodies) checksum += (unsigned long long)body * (i + 1);
+  }
+  return checksum;
+}
+
+/**
+ *  Steps a scene a number of frames, updating the moving bodies and querying
+ *  the area each of them sweeps.
+ *
+ *  @param  num_candidates  Set to the number of bodies found by all queries.
+ *  @param  checksum        Set to a sum over the bodies found, also by queries
+ *                          beyond the scene afterwards, which does not depend
+ *                          on the order they were reported in.
+ *  @return The average time per frame in seconds.
+ */
+double _stepScene(Broadphase & broadphase,
+                  Scene scene,
+                  int num_frames,
+                  long & num_candidates,
+                  unsigned long long & checksum)
+{
+  vector<BroadphaseProxy> proxies;
+  for (size_t i = 0; i < scene.bounds.size(); i++)
+  {
+    proxies.push_back(broadphase.insert(scene.bounds[i],
+                                        (void*)(i + 1),
+                                        scene.filters[i]));
+  }
+
+  vector<void*> candidates;
+  num_candidates = 0;
+  checksum = 0;
+  const double start_time = now();
+  for (int frame = 0; frame < num_frames; frame++)
+  {
+    for (auto i : scene.dynamic_bodies)
+    {
+      scene.bounds[i].min += scene.velocities[i];
+      scene.bounds[i].max += scene.velocities[i];
+      broadphase.update(proxies[i], scene.bounds[i]);
+    }
+    for (auto i : scene.dynamic_bodies)
+    {
+      candidates.clear();
+      broadphase.query(sweep(scene.bounds[i], scene.velocities[i]),
+                       scene.filters[i].mask,
+                       candidates);
+      num_candidates += candidates.size();
+      for (auto body : candidates)
+      {
+        checksum += (unsigned long long)body * (i + 1);
+      }
+    }
+  }
+  const double frame_time = (now() - start_time) / num_frames;
+
+  checksum += _queryBeyondScene(broadphase, proxies.front());
+  return frame_time;
+}
+
+/**
+ *  Steps a scene a number of frames with a sweep and prune broadphase, reading
+ *  out the overlapping pairs after every frame.
+ *
+ *  @param  pairs  Set to the pairs overlapping after the last frame.
+ *  @return The average time per frame in seconds.
+ */
+double _stepPairs(Scene & scene,
+                  int num_frames,
+                  vector<BroadphasePair> & pairs)
+{
+  SweepAndPrune broadphase;
+  vector<BroadphaseProxy> proxies;
+  for (size_t i = 0; i < scene.bounds.size(); i++)
+  {
+    proxies.push_back(broadphase.insert(scene.bounds[i],
+                                        (void*)(i + 1),
+                                        scene.filters[i]));
+  }
+
+  const double start_time = now();
+  for (int frame = 0; frame < num_frames; frame++)
+  {
+    for (auto i : scene.dynamic_bodies)
+    {
+      scene.bounds[i].min += scene.velocities[i];
+      scene.bounds[i].max += scene.velocities[i];
+      broadphase.update(proxies[i], scene.bounds[i]);
+    }
+    pairs.clear();
+    broadphase.pairs(pairs);
+  }
+  return (now() - start_time) / num_frames;
+}
+
+/**
+ *  Finds the overlapping pairs of a scene by testing all pairs of bodies.
+ *
+ *  @return The time taken in seconds.
+ */
+double _findPairs(const Scene & scene, vector<BroadphasePair> & pairs)
+{
+  const double start_time = now();
+  for (size_t i = 0; i < scene.bounds.size(); i++)
+  {
+    for (size_t j = i + 1; j < scene.bounds.size(); j++)
+    {
+      if (should_collide(scene.filters[i], scene.filters[j]) &&
+          overlaps(scene.bounds[i], scene.bounds[j]))
+      {
+        pairs.push_back({(void*)(i + 1), (void*)(j + 1)});
+      }
+    }
+  }
+  return now() - start_time;
+}
+
+unsigned long long _pairChecksum(const vector<BroadphasePair> & pairs)
+{
+  unsigned long long checksum = 0;
+  for (auto & pair : pairs)
+  {
+    const unsigned long long a = (unsigned long long)pair.body_a;
+    const unsigned long long b = (unsigned long long)pair.body_b;
+    checksum += a < b ? a * 65537 + b : b * 65537 + a;
+  }
+  return checksum;
+}
+
+// MARK: Benchmarks
+
+bool benchmark_broadphase_queries(int num_frames)
+{
+  printf("%-16s %8s %14s %14s %12s\n",
+         "broadphase", "bodies", "ns/frame", "ns/query", "candidates");
+  bool matches_all = true;
+  for (int num_bodies : {100, 1000, 10000})
+  {
+    const Scene scene(num_bodies, 17);
+    const double num_queries = (double)scene.dynamic_bodies.size() * num_frames;
+
+    vector<pair<string, Broadphase*>> broadphases
+    {
+      {"brute force",     new BruteForce()},
+      {"spatial hash",    new SpatialHash()},
+      {"aabb tree",       new AABBTree()},
+      {"sweep and prune", new SweepAndPrune()}
+    };
+    unsigned long long reference_checksum = 0;
+    for (auto entry : broadphases)
+    {
+      long num_candidates;
+      unsigned long long checksum;
+      const double frame_time = _stepScene(*entry.second,
+                                           scene,
+                                           num_frames,
+                                           num_candidates,
+                                           checksum);
+      if (entry.second == broadphases.front().second)
+      {
+        reference_checksum = checksum;
+      }
+      const bool matches = checksum == reference_checksum;
+      matches_all = matches_all && matches;
+
+      printf("%-16s %8d %14.0f %14.1f %12ld%s\n",
+             entry.first.c_str(),
+             num_bodies,
+             frame_time * 1e9,
+             frame_time * 1e9 * num_frames / num_queries,
+             num_candidates,
+             matches ? "" : "  (differs from brute force)");
+      delete entry.second;
+    }
+  }
+  return matches_all;
+}
+
+bool benchmark_broadphase_pairs(int num_frames)
+{
+  printf("\n%-16s %8s %14s %12s\n",
+         "pairs", "bodies", "ns/frame", "pairs");
+  bool matches_all = true;
+  for (int num_bodies : {100, 1000, 10000})
+  {
+    Scene scene(num_bodies, 17);
+    vector<BroadphasePair> pairs, reference_pairs;
+    const double frame_time = _stepPairs(scene, num_frames, pairs);
+    const double reference_time = _findPairs(scene, reference_pairs);
+    const bool matches = pairs.size() == reference_pairs.size() &&
+      _pairChecksum(pairs) == _pairChecksum(reference_pairs);
+    matches_all = matches_all && matches;
+
+    printf("%-16s %8d %14.0f %12zu\n",
+           "brute force",
+           num_bodies,
+           reference_time * 1e9,
+           reference_pairs.size());
+    printf("%-16s %8d %14.0f %12zu%s\n",
+           "sweep and prune",
+           num_bodies,
+           frame_time * 1e9,
+           pairs.size(),
+           matches ? "" : "  (differs from brute force)");
+  }
+  return matches_all;
+}
@@ -0,0 +1,105 @@
+//
+//  integrators.cpp
+//  Benchmark
+//
+
+#include <vector>
+#include "benchmark.hpp"
+#include "integration.hpp"
+
+
+//
+// MARK: - Integration benchmarks
+//
+
+// MARK: Helper functions
+
+/**
+ *  Drops a body from rest for a second in steps of the given duration.
+ *
+ *  @return How far from the exact fall the body ends up, in pixels.
+ */
+double _fallError(Integrator integrator, int steps_per_second)
+{
+  const Vector2 acceleration {0, 9.82 * 120};
+  const double step_time = 1.0 / steps_per_second;
+  Vector2 velocity {0, 0};
+  Vector2 distance {0, 0};
+  for (int i = 0; i < steps_per_second; i++)
+  {
+    integrate(velocity,
+              distance,
+              acceleration * step_time,
+              step_time,
+              integrator);
+  }
+  return fabs(distance.y - acceleration.y / 2);
+}
+
+/**
+ *  Steps bodies falling at different speeds one at a time, the way the
+ *  physics phase integrates them.
+ *
+ *  @return The time per body and step, in nanoseconds.
+ */
+double _stepTime(Integrator integrator, int num_bodies, int num_steps)
+{
+  const double step_time = 1.0 / 120;
+  const Vector2 velocity_change {0, 9.82 * 120 * step_time};
+  vector<Vector2> velocities, distances(num_bodies);
+  for (int i = 0; i < num_bodies; i++)
+  {
+    velocities.push_back({(double)(i % 480 - 240), (double)(i % 360 - 180)});
+  }
+
+  const double start_time = now();
+  for (int step = 0; step < num_steps; step++)
+  {
+    for (int i = 0; i < num_bodies; i++)
+    {
+      integrate(velocities[i],
+                distances[i],
+                velocity_change,
+                step_time,
+                integrator);
+    }
+  }
+  const double time = now() - start_time;
+
+  // keep the steps from being optimized away
+  double sum = 0;
+  for (auto & distance : distances) sum += distance.x + distance.y;
+  if (sum == 0) printf("%f\n", sum);
+
+  return time * 1e9 / ((double)num_bodies * num_steps);
+}
+
+// MARK: Benchmarks
+
+void benchmark_integration()
+{
+  //// compare how far off a one second fall ends up at different frame rates
+  printf("\n%-16s %8s %16s %15s\n",
+         "fall error", "steps/s", "semi-implicit px", "verlet px");
+  for (int steps_per_second : {30, 60, 144})
+  {
+    printf("%-16s %8d %16.3f %15.3f\n",
+           "",
+           steps_per_second,
+           _fallError(SEMI_IMPLICIT_EULER, steps_per_second),
+           _fallError(VELOCITY_VERLET, steps_per_second));
+  }
+
+  //// time the steps, which bound what integrating in batches could save
+  printf("\n%-16s %8s %16s %15s\n",
+         "integration", "bodies", "semi-implicit ns", "verlet ns");
+  for (int num_bodies : {1000, 10000, 100000})
+  {
+    const int num_steps = 10000000 / num_bodies;
+    printf("%-16s %8d %16.3f %15.3f\n",
+           "",
+           num_bodies,
+           _stepTime(SEMI_IMPLICIT_EULER, num_bodies, num_steps),
+           _stepTime(VELOCITY_VERLET, num_bodies, num_steps));
+  }
+}
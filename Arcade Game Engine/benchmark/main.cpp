@@ -0,0 +1,42 @@
+//
+//  main.cpp
+//  Benchmark
+//
+
+#include <chrono>
+#include <string.h>
+#include "benchmark.hpp"
+
+double now()
+{
+  using namespace chrono;
+  auto time = steady_clock::now().time_since_epoch();
+  return duration_cast<duration<double>>(time).count();
+}
+
+int main(int argc, char * argv[])
+{
+  const int num_frames = argc > 1 ? atoi(argv[1]) : 20;
+
+  // the scaling benchmarks take long, so they are run on their own
+  if (argc > 3 && strcmp(argv[2], "--scaling") == 0)
+  {
+    FILE * report = fopen(argv[3], "w");
+    if (!report)
+    {
+      fprintf(stderr, "Could not open %s\n", argv[3]);
+      return 1;
+    }
+    const bool matches = benchmark_scaling(num_frames, report);
+    fclose(report);
+    return matches ? 0 : 1;
+  }
+
+  bool matches = benchmark_broadphase_queries(num_frames);
+  matches = benchmark_broadphase_pairs(num_frames) && matches;
+  matches = benchmark_narrowphase(num_frames * 50000) && matches;
+  matches = benchmark_overlaps(num_frames * 500000) && matches;
+  benchmark_integration();
+
+  return matches ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+//
+//  memory.cpp
+//  Benchmark
+//
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#include "benchmark.hpp"
+
+
+//
+// MARK: - Memory
+//
+
+// MARK: Helper functions
+
+// every allocation is prefixed by its size, padded to keep the alignment
+const size_t _HEADER_SIZE = 16;
+
+// the audio callback of the core allocates on a thread of its own
+atomic<size_t> _allocated_bytes(0);
+
+void * _allocate(size_t size)
+{
+  char * block = (char*)malloc(size + _HEADER_SIZE);
+  if (!block) throw bad_alloc();
+  *(size_t*)block = size;
+  _allocated_bytes += size;
+  return block + _HEADER_SIZE;
+}
+
+void _deallocate(void * pointer)
+{
+  if (!pointer) return;
+  char * block = (char*)pointer - _HEADER_SIZE;
+  _allocated_bytes -= *(size_t*)block;
+  free(block);
+}
+
+// MARK: Allocation functions
+
+size_t allocated_bytes()
+{
+  return _allocated_bytes;
+}
+
+void * operator new(size_t size) { return _allocate(size); }
+void * operator new[](size_t size) { return _allocate(size); }
+void operator delete(void * pointer) noexcept { _deallocate(pointer); }
+void operator delete[](void * pointer) noexcept { _deallocate(pointer); }
+
+void operator delete(void * pointer, size_t) noexcept
+{
+  _deallocate(pointer);
+}
+
+void operator delete[](void * pointer, size_t) noexcept
+{
+  _deallocate(pointer);
+}
@@ -0,0 +1,436 @@
+//
+//  narrowphase.cpp
+//  Benchmark
+//
+
+#include <cmath>
+#include <deque>
+#include <random>
+#include "benchmark.hpp"
+
+
+//
+// MARK: - Narrowphase benchmarks
+//
+
+// MARK: Free functions
+
+void legacy_resolve_collisions(Entity & collider,
+                               Entity & obsticle,
+                               Vector2 & travel_distance,
+                               bool collision_response,
+                               vector<Entity*> & result)
+{
+  if (collider.physics() && obsticle.physics() && &collider != &obsticle)
+  {
+    Rectangle collider_cb = collider.physics()->collision_bounds();
+    Rectangle obsticle_cb = obsticle.physics()->collision_bounds();
+    Vector2 col_pos, obs_pos;
+    collider.calculateWorldPosition(col_pos);
+    obsticle.calculateWorldPosition(obs_pos);
+    
+    SDL_Rect collider_before_rect
+    {
+      (int)(col_pos.x + collider_cb.pos.x),
+      (int)(col_pos.y + collider_cb.pos.y),
+      (int)collider_cb.dim.x,
+      (int)collider_cb.dim.y
+    };
+    
+    SDL_Rect obsticle_rect
+    {
+      (int)(obs_pos.x + obsticle_cb.pos.x),
+      (int)(obs_pos.y + obsticle_cb.pos.y),
+      (int)obsticle_cb.dim.x,
+      (int)obsticle_cb.dim.y
+    };
+    
+    // second condition is a hack for enemies not colliding away from each other
+    bool is_responding = collision_response && !obsticle.physics()->dynamic();
+    
+    // check so that the collider is not already colliding with obsticle
+    SDL_Rect intersection_rect;
+    if (!SDL_IntersectRect(&collider_before_rect,
+                           &obsticle_rect,
+                           &intersection_rect))
+    {
+      // collider is outside of obsticle
+      SDL_Rect collider_after_rect
+      {
+        (int)(col_pos.x + collider_cb.pos.x + travel_distance.x),
+        (int)(col_pos.y + collider_cb.pos.y + travel_distance.y),
+        (int)collider_cb.dim.x,
+        (int)collider_cb.dim.y
+      };
+      
+      // the bounding box for the colliders before and after traviling the
+      // distance
+      SDL_Rect large_rect;
+      large_rect.x = (int)min(min_x(collider_before_rect),
+                              min_x(collider_after_rect));
+      large_rect.y = (int)min(min_y(collider_before_rect),
+                              min_y(collider_after_rect));
+      large_rect.w = (int)max(max_x(collider_before_rect),
+                              max_x(collider_after_rect)) - large_rect.x;
+      large_rect.h = (int)max(max_y(collider_before_rect),
+                              max_y(collider_after_rect)) - large_rect.y;
+      
+      if (SDL_IntersectRect(&large_rect, &obsticle_rect, &intersection_rect))
+      {
+        // collider will collide with obsticle between this frame and the next
+        result.push_back(&obsticle);
+        
+        if (is_responding)
+        {
+          typedef struct { int x1, y1, x2, y2; } Line;
+          
+          auto distance = [](int x1, int y1, int x2, int y2)
+          {
+            double dx = x2-x1;
+            double dy = y2-y1;
+            return sqrt(dx*dx+dy*dy);
+          };
+          
+          Line upper_left, upper_right, lower_left, lower_right;
+          
+          upper_left.x1  = (int)min_x(collider_before_rect);
+          upper_left.y1  = (int)min_y(collider_before_rect);
+          upper_left.x2  = (int)min_x(collider_after_rect);
+          upper_left.y2  = (int)min_y(collider_after_rect);
+          
+          upper_right.x1 = (int)max_x(collider_before_rect);
+          upper_right.y1 = (int)min_y(collider_before_rect);
+          upper_right.x2 = (int)max_x(collider_after_rect);
+          upper_right.y2 = (int)min_y(collider_after_rect);
+          
+          lower_left.x1  = (int)min_x(collider_before_rect);
+          lower_left.y1  = (int)max_y(collider_before_rect);
+          lower_left.x2  = (int)min_x(collider_after_rect);
+          lower_left.y2  = (int)max_y(collider_after_rect);
+          
+          lower_right.x1 = (int)max_x(collider_before_rect);
+          lower_right.y1 = (int)max_y(collider_before_rect);
+          lower_right.x2 = (int)max_x(collider_after_rect);
+          lower_right.y2 = (int)max_y(collider_after_rect);
+          
+          int intersections = 0;
+          intersections += SDL_IntersectRectAndLine(&obsticle_rect,
+                                                        &upper_left.x1,
+                                                        &upper_left.y1,
+                                                        &upper_left.x2,
+                                                        &upper_left.y2);
+          intersections += SDL_IntersectRectAndLine(&obsticle_rect,
+                                                        &upper_right.x1,
+                                                        &upper_right.y1,
+                                                        &upper_right.x2,
+                                                        &upper_right.y2);
+          intersections += SDL_IntersectRectAndLine(&obsticle_rect,
+                                                        &lower_left.x1,
+                                                        &lower_left.y1,
+                                                        &lower_left.x2,
+                                                        &lower_left.y2);
+          intersections += SDL_IntersectRectAndLine(&obsticle_rect,
+                                                        &lower_right.x1,
+                                                        &lower_right.y1,
+                                                        &lower_right.x2,
+                                                        &lower_right.y2);
+          
+          if (intersections > 0)
+          {
+            //// find the line with the shortest distance to its originating
+            //// corner
+            int current_distance;
+            
+            // upper left corner
+            int index = 0;
+            int shortest_distance = (int)distance((int)min_x(collider_before_rect),
+                                                   (int)min_y(collider_before_rect),
+                                                   upper_left.x1,
+                                                   upper_left.y1);
+            
+            // upper right corner
+            current_distance = (int)distance((int)max_x(collider_before_rect),
+                                             (int)min_y(collider_before_rect),
+                                             upper_right.x1,
+                                             upper_right.y1);
+            if (current_distance < shortest_distance)
+            {
+              index = 1;
+              shortest_distance = current_distance;
+            }
+            
+            // lower left corner
+            current_distance = (int)distance((int)min_x(collider_before_rect),
+                                             (int)max_y(collider_before_rect),
+                                             lower_left.x1,
+                                             lower_left.y1);
+            if (current_distance < shortest_distance)
+            {
+              index = 2;
+              shortest_distance = current_distance;
+            }
+            
+            // lower right corner
+            current_distance = (int)distance((int)max_x(collider_before_rect),
+                                             (int)max_y(collider_before_rect),
+                                             lower_right.x1,
+                                             lower_right.y1);
+            if (current_distance < shortest_distance)
+            {
+              index = 3;
+              shortest_distance = current_distance;
+            }
+            
+            // update travel distance
+            switch (index)
+            {
+              case 0:
+                travel_distance.x = min_x(collider_before_rect)-upper_left.x1;
+                travel_distance.y = min_y(collider_before_rect)-upper_left.y1;
+                break;
+              case 1:
+                travel_distance.x = max_x(collider_before_rect)-upper_right.x1;
+                travel_distance.y = min_y(collider_before_rect)-upper_right.y1;
+                break;
+              case 2:
+                travel_distance.x = min_x(collider_before_rect)-lower_left.x1;
+                travel_distance.y = max_y(collider_before_rect)-lower_left.y1;
+                break;
+              case 3:
+                travel_distance.x = max_x(collider_before_rect)-lower_right.x1;
+                travel_distance.y = max_y(collider_before_rect)-lower_right.y1;
+                break;
+            }
+            
+            // update velocity
+            collider.changeVelocityTo(0, 0);
+          }
+        }
+      }
+    }
+    else
+    {
+      // collider is inside obsticle (rare)
+      result.push_back(&obsticle);
+      
+      if (is_responding)
+      {
+        //// find shortest distance to one of the obsticles edges
+        int current_distance;
+        
+        // distance to upper edge
+        int index = 0;
+        int shortest_distance = 
+          (int)min_y(obsticle_rect) - (int)min_y(collider_before_rect);
+        
+        // distance to lower edge
+        current_distance = (int)max_y(obsticle_rect) - (int)max_y(collider_before_rect);
+        if (current_distance < shortest_distance)
+        {
+          index = 1;
+          shortest_distance = current_distance;
+        }
+        
+        // distance to left edge
+        current_distance = (int)min_x(obsticle_rect) - (int)min_x(collider_before_rect);
+        if (current_distance < shortest_distance)
+        {
+          index = 2;
+          shortest_distance = current_distance;
+        }
+        
+        // distance to right edge
+        current_distance = (int)max_x(obsticle_rect) - (int)max_x(collider_before_rect);
+        if (current_distance < shortest_distance)
+        {
+          index = 3;
+          shortest_distance = current_distance;
+        }
+        
+        // update travel distance
+        switch (index)
+        {
+          case 0:
+            travel_distance.x = 0;
+            travel_distance.y = -(shortest_distance + collider_before_rect.h);
+            break;
+          case 1:
+            travel_distance.x = 0;
+            travel_distance.y = shortest_distance + collider_before_rect.h;
+            break;
+          case 2:
+            travel_distance.x = -(shortest_distance + collider_before_rect.w);
+            travel_distance.y = 0;
+            break;
+          case 3:
+            travel_distance.x = shortest_distance + collider_before_rect.w;
+            travel_distance.y = 0;
+            break;
+        }
+        
+        // update velocity
+        collider.changeVelocityTo(0, 0);
+      }
+    }
+  }
+  
+  for (auto child : obsticle.children())
+  {
+    legacy_resolve_collisions(collider,
+                              *child,
+                              travel_distance,
+                              collision_response,
+                              result);
+  }
+}
+
+// MARK: Benchmarks
+
+bool benchmark_narrowphase(int num_tests)
+{
+  //// generate colliders moving around obsticles of similar size, in whole
+  //// pixels so that the fixed-point sweep finds the same hits
+  mt19937 generator(17);
+  uniform_int_distribution<int> position(0, 64);
+  uniform_int_distribution<int> size(4, 32);
+  uniform_int_distribution<int> speed(-16, 16);
+
+  const int num_cases = 4096;
+  vector<AABB> colliders, obsticles;
+  vector<Vector2> distances;
+  auto box = [&]()
+  {
+    const Vector2 pos {(double)position(generator),
+                       (double)position(generator)};
+    return AABB {pos, pos + Vector2 {(double)size(generator),
+                                     (double)size(generator)}};
+  };
+  for (int i = 0; i < num_cases; i++)
+  {
+    colliders.push_back(box());
+    obsticles.push_back(box());
+    distances.push_back({(double)speed(generator), (double)speed(generator)});
+  }
+
+  // the former narrowphase works on entities, and the fixed-point cases are
+  // placed relative to their collider, like the physics does
+  deque<Entity> collider_entities, obsticle_entities;
+  vector<FixedAABB> fixed_colliders, fixed_obsticles;
+  vector<FixedVector2> fixed_distances;
+  auto add = [](deque<Entity> & entities, AABB bounds)
+  {
+    entities.emplace_back("", 0);
+    PhysicsComponent * physics = new PhysicsComponent();
+    physics->collision_bounds({{0, 0}, bounds.max - bounds.min});
+    entities.back().addPhysics(physics);
+    entities.back().moveTo(bounds.min.x, bounds.min.y);
+  };
+  for (int i = 0; i < num_cases; i++)
+  {
+    add(collider_entities, colliders[i]);
+    add(obsticle_entities, obsticles[i]);
+    fixed_colliders.push_back(to_fixed(colliders[i], colliders[i].min));
+    fixed_obsticles.push_back(to_fixed(obsticles[i], colliders[i].min));
+    fixed_distances.push_back(to_fixed(distances[i]));
+  }
+
+  //// time the narrowphases over the same cases
+  vector<Entity*> collided;
+  long legacy_hits = 0;
+  double start_time = now();
+  for (int i = 0; i < num_tests; i++)
+  {
+    const int j = i % num_cases;
+    Vector2 distance = distances[j];
+    collided.clear();
+    legacy_resolve_collisions(collider_entities[j],
+                              obsticle_entities[j],
+                              distance,
+                              true,
+                              collided);
+    legacy_hits += collided.size();
+  }
+  const double legacy_time = now() - start_time;
+
+  long hits = 0;
+  double time_sum = 0;
+  start_time = now();
+  for (int i = 0; i < num_tests; i++)
+  {
+    const int j = i % num_cases;
+    SweepHit hit;
+    if (sweep_aabb(colliders[j], distances[j], obsticles[j], hit))
+    {
+      hits += 1;
+      time_sum += hit.time;
+    }
+  }
+  const double time = now() - start_time;
+
+  long fixed_hits = 0;
+  long long fixed_time_sum = 0;
+  start_time = now();
+  for (int i = 0; i < num_tests; i++)
+  {
+    const int j = i % num_cases;
+    FixedSweepHit hit;
+    if (sweep_aabb(fixed_colliders[j], fixed_distances[j], fixed_obsticles[j],
+                   hit))
+    {
+      fixed_hits += 1;
+      fixed_time_sum += hit.time.raw;
+    }
+  }
+  const double fixed_time = now() - start_time;
+
+  //// check the fixed-point sweep against the double one on every case,
+  //// where its times may be truncated by up to one step
+  bool matches = true;
+  for (int i = 0; i < num_cases; i++)
+  {
+    SweepHit hit;
+    FixedSweepHit fixed_hit;
+    const bool is_hit = sweep_aabb(colliders[i], distances[i], obsticles[i],
+                                   hit);
+    const bool is_fixed_hit = sweep_aabb(fixed_colliders[i],
+                                         fixed_distances[i],
+                                         fixed_obsticles[i],
+                                         fixed_hit);
+    matches = matches && is_hit == is_fixed_hit;
+    if (is_hit && is_fixed_hit)
+    {
+      const Vector2 normal = to_vector2(fixed_hit.normal);
+      matches = matches &&
+                normal.x == hit.normal.x && normal.y == hit.normal.y &&
+                to_double(fixed_hit.depth) == hit.depth &&
+                abs(to_double(fixed_hit.time) - hit.time) <= 1.0 / FIXED_ONE;
+    }
+  }
+
+  for (auto & entity : collider_entities) entity.destroy();
+  for (auto & entity : obsticle_entities) entity.destroy();
+
+  printf("\n%-16s %8s %14s %12s\n", "narrowphase", "tests", "ns/test", "hits");
+  printf("%-16s %8d %14.2f %12ld\n",
+         "legacy",
+         num_tests,
+         legacy_time * 1e9 / num_tests,
+         legacy_hits);
+  printf("%-16s %8d %14.2f %12ld  (mean time of impact %.3f)\n",
+         "swept aabb",
+         num_tests,
+         time * 1e9 / num_tests,
+         hits,
+         hits > 0 ? time_sum / hits : 0);
+  printf("%-16s %8d %14.2f %12ld  (mean time of impact %.3f)%s\n",
+         "fixed point",
+         num_tests,
+         fixed_time * 1e9 / num_tests,
+         fixed_hits,
+         fixed_hits > 0
+           ? (double)fixed_time_sum / FIXED_ONE / fixed_hits
+           : 0,
+         matches ? "" : "  MISMATCH");
+
+  return matches;
+}
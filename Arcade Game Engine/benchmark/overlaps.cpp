@@ -0,0 +1,96 @@
+//
+//  overlaps.cpp
+//  Benchmark
+//
+
+#include <random>
+#include "benchmark.hpp"
+
+
+//
+// MARK: - Overlap benchmarks
+//
+
+// MARK: Benchmarks
+
+bool benchmark_overlaps(int num_tests)
+{
+  bool matches = true;
+  
+  printf("\n%-16s %8s %15s %14s %12s\n",
+         "overlaps", "boxes", "scalar tests/ns", "batch tests/ns", "hits");
+  
+  for (int num_boxes : {16, 256, 4096})
+  {
+    //// generate boxes and areas of about the size of sprites
+    mt19937 generator(num_boxes);
+    const double side = sqrt((double)num_boxes) * 32;
+    uniform_real_distribution<double> position(0, side);
+    uniform_real_distribution<double> size(4, 32);
+    
+    vector<AABB> boxes;
+    AABBArray box_array;
+    for (int i = 0; i < num_boxes; i++)
+    {
+      const Vector2 pos {position(generator), position(generator)};
+      boxes.push_back({pos, pos + Vector2 {size(generator), size(generator)}});
+      box_array.push_back(boxes.back());
+    }
+    
+    const int num_areas = 256;
+    vector<AABB> areas;
+    for (int i = 0; i < num_areas; i++)
+    {
+      const Vector2 pos {position(generator), position(generator)};
+      areas.push_back({pos, pos + Vector2 {size(generator), size(generator)}});
+    }
+    
+    //// test every box against the areas, one box at a time and in batches
+    const int num_passes = max(1, num_tests / num_boxes);
+    vector<int> scalar_hits, batch_hits;
+    double start_time = now();
+    for (int i = 0; i < num_passes; i++)
+    {
+      const AABB area = areas[i % num_areas];
+      scalar_hits.clear();
+      for (int j = 0; j < num_boxes; j++)
+      {
+        if (overlaps(area, boxes[j])) scalar_hits.push_back(j);
+      }
+    }
+    const double scalar_time = now() - start_time;
+    
+    long num_hits = 0;
+    start_time = now();
+    for (int i = 0; i < num_passes; i++)
+    {
+      batch_hits.clear();
+      num_hits += find_overlaps(areas[i % num_areas], box_array, batch_hits);
+    }
+    const double batch_time = now() - start_time;
+    
+    //// check the kernel against the scalar test on every area
+    for (auto & area : areas)
+    {
+      scalar_hits.clear();
+      batch_hits.clear();
+      for (int j = 0; j < num_boxes; j++)
+      {
+        if (overlaps(area, boxes[j])) scalar_hits.push_back(j);
+      }
+      find_overlaps(area, box_array, batch_hits);
+      matches = matches && scalar_hits == batch_hits;
+    }
+    
+    const double num_box_tests = (double)num_passes * num_boxes;
+    printf("%-16s %8d %15.2f %14.2f %12ld%s\n",
+           "",
+           num_boxes,
+           num_box_tests / (scalar_time * 1e9),
+           num_box_tests / (batch_time * 1e9),
+           num_hits,
+           matches ? "" : "  MISMATCH");
+  }
+  
+  return matches;
+}
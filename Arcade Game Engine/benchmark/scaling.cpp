@@ -0,0 +1,398 @@
+//
+//  scaling.cpp
+//  Benchmark
+//
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <string>
+#include "benchmark.hpp"
+
+
+//
+// MARK: - Physics scene
+//
+
+const CollisionLayer BLOCK_LAYER = 1 << 0;
+const CollisionLayer BODY_LAYER  = 1 << 1;
+const CollisionLayer WALL_LAYER  = 1 << 2;
+const double TILE_SIZE = 32;
+const double BODY_SIZE = 30;
+const double TIME_STEP = 1.0 / 60;
+
+/**
+ *  Defines a scene of static blocks on a grid of tiles, with dynamic bodies
+ *  falling and bouncing about between them, enclosed by walls. The blocks and
+ *  bodies start out on separate tiles, a few pixels apart, and the bodies
+ *  collide with the blocks, the walls and each other.
+ */
+struct PhysicsScene
+{
+  // the bounds of the blocks, followed by those of the bodies
+  vector<AABB> bounds;
+  vector<Vector2> velocities;
+  vector<AABB> walls;
+  int num_blocks;
+  double side;
+
+  PhysicsScene(int num_blocks, int num_bodies, unsigned seed)
+    : num_blocks(num_blocks)
+  {
+    mt19937 generator(seed);
+    uniform_real_distribution<double> speed(-480, 480);
+
+    //// spread the blocks and bodies over a grid with twice as many tiles
+    const int num_columns =
+      (int)ceil(sqrt(2.0 * (num_blocks + num_bodies)));
+    side = num_columns * TILE_SIZE;
+    vector<int> tiles(num_columns * num_columns);
+    iota(tiles.begin(), tiles.end(), 0);
+    shuffle(tiles.begin(), tiles.end(), generator);
+
+    for (int i = 0; i < num_blocks + num_bodies; i++)
+    {
+      const Vector2 tile {(tiles[i] % num_columns) * TILE_SIZE,
+                          (tiles[i] / num_columns) * TILE_SIZE};
+      if (i < num_blocks)
+      {
+        bounds.push_back({tile, tile + TILE_SIZE});
+      }
+      else
+      {
+        const Vector2 pos = tile + (TILE_SIZE - BODY_SIZE) / 2;
+        bounds.push_back({pos, pos + BODY_SIZE});
+        velocities.push_back({speed(generator), speed(generator)});
+      }
+    }
+
+    //// keep the bodies from falling out of the grid
+    walls.push_back({{-TILE_SIZE, side}, {side + TILE_SIZE, side + TILE_SIZE}});
+    walls.push_back({{-TILE_SIZE, -side}, {0, side}});
+    walls.push_back({{side, -side}, {side + TILE_SIZE, side}});
+  }
+};
+
+
+//
+// MARK: - Scaling benchmarks
+//
+
+// MARK: Helper functions
+
+/**
+ *  Defines the broadphases to keep the blocks and bodies of a scene in.
+ */
+struct _BroadphaseSetup
+{
+  string name;
+
+  // whether queries or insertions scan all bodies, which limits the sizes of
+  // the scenes it is run on
+  bool is_quadratic;
+
+  function<Broadphase*(void)> create_blocks;
+
+  // creates a separate broadphase for the bodies and walls, or is empty to
+  // keep them with the blocks
+  function<Broadphase*(void)> create_bodies;
+};
+
+struct _ScalingResult
+{
+  bool did_run;
+  double frame_time;
+  double pairs_tested;
+  double contacts;
+  size_t num_asleep;
+  size_t memory;
+
+  // a sum over where the bodies ended up, which runs that play out the same
+  // agree on
+  double checksum;
+};
+
+/**
+ *  Defines the entities of a scene, with the walls, the blocks and the bodies
+ *  as children of the root in that order.
+ */
+struct _SceneTree
+{
+  Entity root;
+  deque<Entity> entities;
+  vector<Entity*> bodies;
+
+  _SceneTree(const PhysicsScene & scene)
+    : root("root", 0)
+  {
+    auto add = [this](AABB bounds, CollisionLayer layer, bool is_dynamic)
+    {
+      entities.emplace_back("", 0);
+      Entity * entity = &entities.back();
+      PhysicsComponent * physics = new PhysicsComponent();
+      physics->collision_bounds({{0, 0}, bounds.max - bounds.min});
+      physics->layer(layer);
+      physics->dynamic(is_dynamic);
+      physics->collision_detection(is_dynamic);
+      physics->collision_response(is_dynamic);
+      entity->addPhysics(physics);
+      entity->moveTo(bounds.min.x, bounds.min.y);
+      root.addChild(entity);
+      return entity;
+    };
+
+    for (auto & wall : scene.walls) add(wall, WALL_LAYER, false);
+    for (size_t i = 0; i < scene.bounds.size(); i++)
+    {
+      const bool is_block = (int)i < scene.num_blocks;
+      Entity * entity = add(scene.bounds[i],
+                            is_block ? BLOCK_LAYER : BODY_LAYER,
+                            !is_block);
+      if (is_block) continue;
+
+      const Vector2 velocity = scene.velocities[i - scene.num_blocks];
+      entity->changeVelocityTo(velocity.x, velocity.y);
+      bodies.push_back(entity);
+    }
+  }
+
+  // the core destroys the tree as well, after which the root has no children
+  ~_SceneTree()
+  {
+    root.destroy();
+  }
+
+  double checksum()
+  {
+    double sum = 0;
+    for (auto body : bodies)
+    {
+      Vector2 position;
+      body->calculateWorldPosition(position);
+      sum += position.x + position.y;
+    }
+    return sum;
+  }
+};
+
+/**
+ *  Steps the physics of a scene with a core, in frames of two sub-steps each,
+ *  after a first frame that puts the bodies in the broadphases. The time is
+ *  that of the physics phase, and the memory that held by the scene after the
+ *  first frame, which only differs between runs by the broadphases.
+ */
+_ScalingResult _stepCore(const PhysicsScene & scene,
+                         const _BroadphaseSetup & setup,
+                         int num_frames)
+{
+  const size_t memory_start = allocated_bytes();
+  _SceneTree tree(scene);
+  Core core;
+  core.fixed_delta_time(TIME_STEP);
+  core.physics_step(TIME_STEP / 2);
+  if (setup.create_bodies)
+  {
+    core.useBroadphase(setup.create_blocks(), BLOCK_LAYER);
+    core.useBroadphase(setup.create_bodies());
+  }
+  else
+  {
+    core.useBroadphase(setup.create_blocks());
+  }
+  if (!core.init(&tree.root, "Benchmark", {64, 64})) return {false};
+
+  core.update();
+  const size_t memory = allocated_bytes() - memory_start;
+
+  double duration = 0;
+  long num_tested = 0;
+  long num_contacts = 0;
+  for (int frame = 0; frame < num_frames; frame++)
+  {
+    core.update();
+    duration += core.physics_stats().duration;
+    num_tested += core.physics_stats().pairs;
+    num_contacts += core.physics_stats().contacts;
+  }
+  const size_t num_asleep = count_if(tree.bodies.begin(),
+                                     tree.bodies.end(),
+                                     [](Entity * body)
+  {
+    return body->physics()->sleeping();
+  });
+  const double checksum = tree.checksum();
+
+  core.destroy();
+  return
+  {
+    true,
+    duration / num_frames,
+    (double)num_tested / num_frames,
+    (double)num_contacts / num_frames,
+    num_asleep,
+    memory,
+    checksum
+  };
+}
+
+/**
+ *  Steps the bodies of a scene the way the former physics phase did, which
+ *  integrated their velocities once per frame and tested each of them against
+ *  the whole tree with the former narrowphase.
+ */
+_ScalingResult _stepLegacy(const PhysicsScene & scene, int num_frames)
+{
+  const size_t memory_start = allocated_bytes();
+  _SceneTree tree(scene);
+  const size_t memory = allocated_bytes() - memory_start;
+
+  vector<Entity*> collided;
+  long num_tested = 0;
+  long num_contacts = 0;
+  const double start_time = now();
+  for (int frame = 0; frame < num_frames; frame++)
+  {
+    for (auto body : tree.bodies)
+    {
+      const Vector2 velocity = body->physics()->gravity() * TIME_STEP *
+                               PhysicsComponent::pixels_per_meter;
+      body->changeVelocityBy(velocity.x, velocity.y);
+      Vector2 distance = body->velocity() * TIME_STEP;
+
+      collided.clear();
+      legacy_resolve_collisions(*body, tree.root, distance, true, collided);
+      body->moveBy(distance.x, distance.y);
+      num_tested += tree.entities.size() - 1;
+      num_contacts += collided.size();
+    }
+  }
+  const double frame_time = (now() - start_time) / num_frames;
+
+  return
+  {
+    true,
+    frame_time,
+    (double)num_tested / num_frames,
+    (double)num_contacts / num_frames,
+    0,
+    memory,
+    tree.checksum()
+  };
+}
+
+// MARK: Benchmarks
+
+bool benchmark_scaling(int num_frames, FILE * report)
+{
+  const vector<_BroadphaseSetup> setups
+  {
+    {"brute force",     true,  [] { return new BruteForce(); },    nullptr},
+    {"spatial hash",    false, [] { return new SpatialHash(); },   nullptr},
+    {"aabb tree",       false, [] { return new AABBTree(); },      nullptr},
+    {"sweep and prune", true,  [] { return new SweepAndPrune(); }, nullptr},
+    {
+      "tile grid",
+      false,
+      [] { return new TileGrid({0, 0}, {0, TILE_SIZE}, TILE_SIZE); },
+      [] { return new SpatialHash(TILE_SIZE); }
+    }
+  };
+  const int sizes[] {10, 100, 1000, 10000, 100000};
+  const int max_quadratic_bodies = 20000;
+  const int max_legacy_bodies = 2000;
+
+  printf("\n%-16s %8s %8s %12s %12s %10s %8s %12s\n",
+         "scaling", "blocks", "bodies",
+         "ns/body", "tested", "contacts", "asleep", "bytes");
+  fprintf(report, "{\n  \"frames\": %d,\n  \"results\": [", num_frames);
+
+  bool matches_all = true;
+  bool is_first_result = true;
+  auto print = [&](const char * name,
+                   int num_blocks,
+                   int num_bodies,
+                   const _ScalingResult & result,
+                   bool matches)
+  {
+    const double ns_per_body = result.frame_time * 1e9 / num_bodies;
+    printf("%-16s %8d %8d %12.1f %12.1f %10.1f %8zu %12zu%s\n",
+           name,
+           num_blocks,
+           num_bodies,
+           ns_per_body,
+           result.pairs_tested,
+           result.contacts,
+           result.num_asleep,
+           result.memory,
+           matches ? "" : "  (differs from the others)");
+    fprintf(report,
+            "%s\n    {\"setup\": \"%s\", \"blocks\": %d, \"bodies\": %d, "
+            "\"ns_per_body\": %.3f, \"pairs_tested\": %.3f, "
+            "\"contacts\": %.3f, \"asleep\": %zu, \"memory_bytes\": %zu, "
+            "\"matches\": %s}",
+            is_first_result ? "" : ",",
+            name,
+            num_blocks,
+            num_bodies,
+            ns_per_body,
+            result.pairs_tested,
+            result.contacts,
+            result.num_asleep,
+            result.memory,
+            matches ? "true" : "false");
+    is_first_result = false;
+  };
+
+  for (int num_blocks : sizes)
+  {
+    for (int num_bodies : sizes)
+    {
+      const PhysicsScene scene(num_blocks, num_bodies, 17);
+
+      // the former physics phase serves as the baseline
+      if (num_blocks + num_bodies <= max_legacy_bodies)
+      {
+        print("legacy",
+              num_blocks,
+              num_bodies,
+              _stepLegacy(scene, num_frames),
+              true);
+      }
+
+      // every broadphase finds the same bodies, which the core reports in
+      // tree order, so the scenes should play out the same
+      bool has_reference = false;
+      _ScalingResult reference;
+      for (auto & setup : setups)
+      {
+        if (setup.is_quadratic &&
+            num_blocks + num_bodies > max_quadratic_bodies)
+        {
+          continue;
+        }
+
+        const _ScalingResult result = _stepCore(scene, setup, num_frames);
+        if (!result.did_run)
+        {
+          fprintf(stderr, "Could not initialize the core\n");
+          return false;
+        }
+        if (!has_reference)
+        {
+          has_reference = true;
+          reference = result;
+        }
+        const bool matches = result.pairs_tested == reference.pairs_tested &&
+                             result.contacts == reference.contacts &&
+                             result.num_asleep == reference.num_asleep &&
+                             result.checksum == reference.checksum;
+        matches_all = matches_all && matches;
+        print(setup.name.c_str(), num_blocks, num_bodies, result, matches);
+      }
+    }
+  }
+  fprintf(report, "\n  ]\n}\n");
+  return matches_all;
+}
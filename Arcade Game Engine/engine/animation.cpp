@@ -6,6 +6,13 @@
 #include "core.hpp"
 #include <fstream>
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define _USE_SSE2
+#endif
+
 // MARK: Helper functions
 inline double transform_from_range(double value,
                                    double from_low_bound,
@@ -16,6 +23,248 @@ inline double transform_from_range(double value,
   return value/(from_high_bound-from_low_bound)*(to_high_bound-to_low_bound);
 }
 
+/**
+ *  Evaluates a segment of a cubic hermite curve in fixed point.
+ *
+ *  @param  t   How far along the segment to evaluate it, in [0, 1].
+ *  @param  s0  The point and velocity at the start of the segment.
+ *  @param  s1  The point and velocity at the end of the segment.
+ */
+inline FixedVector2 fixed_hermite(Fixed t,
+                                  pair<Vector2, Vector2> s0,
+                                  pair<Vector2, Vector2> s1)
+{
+  const Fixed one {FIXED_ONE};
+  const Fixed t2 = t*t;
+  const Fixed t3 = t2*t;
+  const Fixed two_t3 = t3 + t3;
+  const Fixed three_t2 = t2 + t2 + t2;
+  const Fixed cp0 = two_t3 - three_t2 + one;
+  const Fixed cm0 = t3 - t2 - t2 + t;
+  const Fixed cm1 = t3 - t2;
+  const Fixed cp1 = three_t2 - two_t3;
+  return to_fixed(s0.first)*cp0 + to_fixed(s0.second)*cm0 +
+         to_fixed(s1.first)*cp1 + to_fixed(s1.second)*cm1;
+}
+
+/**
+ *  Linearly interpolates between two positions in fixed point.
+ */
+inline FixedVector2 fixed_lerp(Vector2 a, Vector2 b, Fixed t)
+{
+  const FixedVector2 fixed_a = to_fixed(a);
+  return fixed_a + (to_fixed(b) - fixed_a)*t;
+}
+
+
+//
+// MARK: - Hermite arrays
+//
+
+void HermiteArray::push_back(double t,
+                             Vector2 offset,
+                             pair<Vector2, Vector2> s0,
+                             pair<Vector2, Vector2> s1)
+{
+  this->t.push_back(t);
+  offset_x.push_back(offset.x);
+  offset_y.push_back(offset.y);
+  p0_x.push_back(s0.first.x);
+  p0_y.push_back(s0.first.y);
+  m0_x.push_back(s0.second.x);
+  m0_y.push_back(s0.second.y);
+  p1_x.push_back(s1.first.x);
+  p1_y.push_back(s1.first.y);
+  m1_x.push_back(s1.second.x);
+  m1_y.push_back(s1.second.y);
+}
+
+void HermiteArray::clear()
+{
+  t.clear();
+  offset_x.clear();
+  offset_y.clear();
+  p0_x.clear();
+  p0_y.clear();
+  m0_x.clear();
+  m0_y.clear();
+  p1_x.clear();
+  p1_y.clear();
+  m1_x.clear();
+  m1_y.clear();
+}
+
+// MARK: Free functions
+
+void evaluate_hermite(HermiteArray & segments)
+{
+  const size_t count = segments.size();
+  segments.result_x.resize(count);
+  segments.result_y.resize(count);
+  size_t i = 0;
+  
+  // each lane computes the same expressions as the scalar loop below, so the
+  // results do not depend on the instruction set
+#if defined(__AVX__)
+  const __m256d one = _mm256_set1_pd(1);
+  const __m256d two = _mm256_set1_pd(2);
+  const __m256d three = _mm256_set1_pd(3);
+  for (; i + 4 <= count; i += 4)
+  {
+    const __m256d t = _mm256_loadu_pd(&segments.t[i]);
+    const __m256d t2 = _mm256_mul_pd(t, t);
+    const __m256d t3 = _mm256_mul_pd(t2, t);
+    const __m256d two_t3 = _mm256_mul_pd(two, t3);
+    const __m256d three_t2 = _mm256_mul_pd(three, t2);
+    const __m256d cp0 = _mm256_add_pd(_mm256_sub_pd(two_t3, three_t2), one);
+    const __m256d cm0 = _mm256_add_pd(_mm256_sub_pd(t3, _mm256_mul_pd(two, t2)),
+                                      t);
+    const __m256d cm1 = _mm256_sub_pd(t3, t2);
+    const __m256d cp1 = _mm256_sub_pd(three_t2, two_t3);
+    auto evaluate = [&](const vector<double> & offset,
+                        const vector<double> & p0,
+                        const vector<double> & m0,
+                        const vector<double> & p1,
+                        const vector<double> & m1,
+                        vector<double> & result)
+    {
+      __m256d p = _mm256_mul_pd(_mm256_loadu_pd(&p0[i]), cp0);
+      p = _mm256_add_pd(p, _mm256_mul_pd(_mm256_loadu_pd(&m0[i]), cm0));
+      p = _mm256_add_pd(p, _mm256_mul_pd(_mm256_loadu_pd(&p1[i]), cp1));
+      p = _mm256_add_pd(p, _mm256_mul_pd(_mm256_loadu_pd(&m1[i]), cm1));
+      _mm256_storeu_pd(&result[i], _mm256_add_pd(_mm256_loadu_pd(&offset[i]),
+                                                 p));
+    };
+    evaluate(segments.offset_x,
+             segments.p0_x,
+             segments.m0_x,
+             segments.p1_x,
+             segments.m1_x,
+             segments.result_x);
+    evaluate(segments.offset_y,
+             segments.p0_y,
+             segments.m0_y,
+             segments.p1_y,
+             segments.m1_y,
+             segments.result_y);
+  }
+#elif defined(_USE_SSE2)
+  const __m128d one = _mm_set1_pd(1);
+  const __m128d two = _mm_set1_pd(2);
+  const __m128d three = _mm_set1_pd(3);
+  for (; i + 2 <= count; i += 2)
+  {
+    const __m128d t = _mm_loadu_pd(&segments.t[i]);
+    const __m128d t2 = _mm_mul_pd(t, t);
+    const __m128d t3 = _mm_mul_pd(t2, t);
+    const __m128d two_t3 = _mm_mul_pd(two, t3);
+    const __m128d three_t2 = _mm_mul_pd(three, t2);
+    const __m128d cp0 = _mm_add_pd(_mm_sub_pd(two_t3, three_t2), one);
+    const __m128d cm0 = _mm_add_pd(_mm_sub_pd(t3, _mm_mul_pd(two, t2)), t);
+    const __m128d cm1 = _mm_sub_pd(t3, t2);
+    const __m128d cp1 = _mm_sub_pd(three_t2, two_t3);
+    auto evaluate = [&](const vector<double> & offset,
+                        const vector<double> & p0,
+                        const vector<double> & m0,
+                        const vector<double> & p1,
+                        const vector<double> & m1,
+                        vector<double> & result)
+    {
+      __m128d p = _mm_mul_pd(_mm_loadu_pd(&p0[i]), cp0);
+      p = _mm_add_pd(p, _mm_mul_pd(_mm_loadu_pd(&m0[i]), cm0));
+      p = _mm_add_pd(p, _mm_mul_pd(_mm_loadu_pd(&p1[i]), cp1));
+      p = _mm_add_pd(p, _mm_mul_pd(_mm_loadu_pd(&m1[i]), cm1));
+      _mm_storeu_pd(&result[i], _mm_add_pd(_mm_loadu_pd(&offset[i]), p));
+    };
+    evaluate(segments.offset_x,
+             segments.p0_x,
+             segments.m0_x,
+             segments.p1_x,
+             segments.m1_x,
+             segments.result_x);
+    evaluate(segments.offset_y,
+             segments.p0_y,
+             segments.m0_y,
+             segments.p1_y,
+             segments.m1_y,
+             segments.result_y);
+  }
+#endif
+  
+  for (; i < count; i++)
+  {
+    const double t = segments.t[i];
+    const double t2 = t*t;
+    const double t3 = t2*t;
+    const double two_t3 = 2*t3;
+    const double three_t2 = 3*t2;
+    const double cp0 = two_t3 - three_t2 + 1;
+    const double cm0 = t3 - 2*t2 + t;
+    const double cm1 = t3 - t2;
+    const double cp1 = three_t2 - two_t3;
+    const Vector2 p0 {segments.p0_x[i], segments.p0_y[i]};
+    const Vector2 m0 {segments.m0_x[i], segments.m0_y[i]};
+    const Vector2 p1 {segments.p1_x[i], segments.p1_y[i]};
+    const Vector2 m1 {segments.m1_x[i], segments.m1_y[i]};
+    const Vector2 p = p0*cp0 + m0*cm0 + p1*cp1 + m1*cm1;
+    segments.result_x[i] = segments.offset_x[i] + p.x;
+    segments.result_y[i] = segments.offset_y[i] + p.y;
+  }
+}
+
+
+//
+// MARK: - Core
+//
+
+// MARK: Private member functions
+
+void Core::_updateAnimations(vector<Entity*> & entities)
+{
+  const double time = effectiveElapsedTime();
+  _animation_segments.clear();
+  _sampled_animations.clear();
+  _stopped_animations.clear();
+  
+  //// advance the animations under way in update order, where the segments
+  //// of curves evaluated exactly are gathered to be evaluated together
+  for (auto entity : entities)
+  {
+    AnimationComponent * animation = entity->animation();
+    if (!entity->enabled() || !animation || !animation->animating()) continue;
+    
+    const double elapsed = time - animation->_start_time;
+    if (elapsed < animation->_duration)
+    {
+      const size_t num_segments = _animation_segments.size();
+      animation->_advance(*this, elapsed, _animation_segments);
+      if (_animation_segments.size() > num_segments)
+      {
+        _sampled_animations.push_back(animation);
+      }
+    }
+    else
+    {
+      animation->_stop(*this);
+      _stopped_animations.push_back(animation);
+    }
+  }
+  
+  //// evaluate the gathered segments, and move their entities
+  evaluate_hermite(_animation_segments);
+  for (size_t i = 0; i < _sampled_animations.size(); i++)
+  {
+    const Vector2 position = _animation_segments.result(i);
+    _sampled_animations[i]->entity()->moveTo(position.x, position.y);
+  }
+  
+  //// notify observers once all animations have been advanced
+  for (auto animation : _stopped_animations)
+  {
+    NotificationCenter::notify(DidStopAnimating, *animation);
+  }
+}
+
 
 //
 // MARK: - AnimationComponent
@@ -35,11 +284,32 @@ void AnimationComponent::reset()
 
 void AnimationComponent::addSegment(string id, Vector2 point, Vector2 velocity)
 {
-  _curves[id].push_back({point, velocity});
+  // the curve is built here and only registered once it is animated
+  auto it = _pending_curves.find(id);
+  if (it == _pending_curves.end())
+  {
+    auto registered = _curves.find(id);
+    it = _pending_curves.insert({id, registered != _curves.end()
+      ? CurveLibrary::main().curve(registered->second)
+      : CubicHermiteCurve()}).first;
+    _curves.erase(id);
+  }
+  it->second.push_back({point, velocity});
+}
+
+void AnimationComponent::addCurve(string id, CurveHandle curve)
+{
+  _pending_curves.erase(id);
+  _curves[id] = curve;
+  if (baked_samples() > 0)
+  {
+    CurveLibrary::main().samples(curve, baked_samples());
+  }
 }
 
 void AnimationComponent::removeCurve(string id)
 {
+  _pending_curves.erase(id);
   _curves.erase(id);
 }
 
@@ -47,10 +317,31 @@ void AnimationComponent::performAnimation(string id,
                                           double duration,
                                           bool update_velocity)
 {
-  if (!animating() && _curves.find(id) != _curves.end())
+  auto pending = _pending_curves.find(id);
+  if (pending != _pending_curves.end())
+  {
+    addCurve(id, CurveLibrary::main().add(pending->second));
+  }
+  
+  auto it = _curves.find(id);
+  if (it != _curves.end())
+  {
+    performAnimation(it->second, duration, update_velocity);
+  }
+}
+
+void AnimationComponent::performAnimation(CurveHandle curve,
+                                          double duration,
+                                          bool update_velocity)
+{
+  if (!animating() && curve != NULL_CURVE)
   {
+    CurveLibrary & library = CurveLibrary::main();
     animating(true);
-    _current_curve = _curves[id];
+    _current_curve = &library.curve(curve);
+    _current_samples = baked_samples() > 0
+      ? &library.samples(curve, baked_samples())
+      : nullptr;
     _start_position = entity()->local_position();
     _start_time = entity()->core()->effectiveElapsedTime();
     _duration = duration;
@@ -59,43 +350,134 @@ void AnimationComponent::performAnimation(string id,
   }
 }
 
-void AnimationComponent::update(Core & world)
+void AnimationComponent::update(Core &) {
+  // animations are advanced together in the core's batched animation pass
+}
+
+// MARK: Private member functions
+
+void AnimationComponent::_advance(Core & world,
+                                  double elapsed,
+                                  HermiteArray & segments)
 {
-  if (animating())
+  if (_current_samples && _current_samples->size() > 0)
   {
-    const double dt = _duration / (_current_curve.size() - 1);
-    const double elapsed  = world.effectiveElapsedTime() - _start_time;
-    if (elapsed < _duration)
+    // look up the samples around the current time
+    const vector<Vector2> & samples = *_current_samples;
+    const double x = elapsed / _duration * (samples.size() - 1);
+    const int i = min((int)x, (int)samples.size() - 2);
+    const Vector2 a = samples[i];
+    const Vector2 b = samples[i+1];
+    if (world.fixed_point())
     {
-      const int i = (int)floor(elapsed / dt);
-      const double t = fmod(elapsed, dt) / dt;
-      const double t2 = t*t;
-      const double t3 = t2*t;
-      const double two_t3 = 2*t3;
-      const double three_t2 = 3*t2;
-      const double cp0 = two_t3 - three_t2 + 1;
-      const double cm0 = t3 - 2*t2 + t;
-      const double cm1 = t3 - t2;
-      const double cp1 = three_t2 - two_t3;
-      const auto s0 = _current_curve[i];
-      const auto s1 = _current_curve[i+1];
-      const Vector2 p = s0.first*cp0 + s0.second*cm0 +
-                        s1.first*cp1 + s1.second*cm1;
-      
-      entity()->moveTo(_start_position.x + p.x, _start_position.y + p.y);
-    }
-    else
-    {
-      auto last_half_spline = _current_curve.back();
-      entity()->moveTo(_start_position.x + last_half_spline.first.x,
-                       _start_position.y + last_half_spline.first.y);
-      if (_update_velocity)
-      {
-        entity()->changeVelocityTo(last_half_spline.second.x/_duration,
-                                   last_half_spline.second.y/_duration);
-      }
-      animating(false);
-      NotificationCenter::notify(DidStopAnimating, *this);
+      const FixedVector2 p = to_fixed(_start_position) +
+                             fixed_lerp(a, b, to_fixed(x - i));
+      entity()->moveTo(to_double(p.x), to_double(p.y));
+      return;
     }
+    
+    const Vector2 p = a + (b - a)*(x - i);
+    entity()->moveTo(_start_position.x + p.x, _start_position.y + p.y);
+    return;
+  }
+  
+  const CubicHermiteCurve & curve = *_current_curve;
+  const double dt = _duration / (curve.size() - 1);
+  const int i = (int)floor(elapsed / dt);
+  const double t = fmod(elapsed, dt) / dt;
+  if (world.fixed_point())
+  {
+    const FixedVector2 p = to_fixed(_start_position) +
+                           fixed_hermite(to_fixed(t), curve[i], curve[i+1]);
+    entity()->moveTo(to_double(p.x), to_double(p.y));
+    return;
+  }
+  
+  // the segment is evaluated together with those of the other animations
+  segments.push_back(t, _start_position, curve[i], curve[i+1]);
+}
+
+void AnimationComponent::_stop(Core & world)
+{
+  auto last_half_spline = _current_curve->back();
+  Vector2 end_position = _start_position + last_half_spline.first;
+  Vector2 end_velocity {last_half_spline.second.x/_duration,
+                        last_half_spline.second.y/_duration};
+  if (world.fixed_point())
+  {
+    end_position = to_vector2(to_fixed(_start_position) +
+                              to_fixed(last_half_spline.first));
+    end_velocity = round_to_fixed(end_velocity);
+  }
+  entity()->moveTo(end_position.x, end_position.y);
+  if (_update_velocity)
+  {
+    entity()->changeVelocityTo(end_velocity.x, end_velocity.y);
+  }
+  animating(false);
+}
+
+
+//
+// MARK: - CurveLibrary
+//
+
+// MARK: Member functions
+
+CurveLibrary & CurveLibrary::main()
+{
+  static CurveLibrary instance;
+  return instance;
+}
+
+CurveHandle
+CurveLibrary::add(const AnimationComponent::CubicHermiteCurve & curve)
+{
+  // curves are told apart by their exact coordinates
+  vector<double> key;
+  for (auto & segment : curve)
+  {
+    key.insert(key.end(), {segment.first.x, segment.first.y,
+                           segment.second.x, segment.second.y});
+  }
+  
+  auto it = _handles.find(key);
+  if (it != _handles.end()) return it->second;
+  
+  const CurveHandle handle = (CurveHandle)_curves.size();
+  _curves.push_back({curve, {}});
+  _handles[key] = handle;
+  return handle;
+}
+
+const AnimationComponent::CubicHermiteCurve &
+CurveLibrary::curve(CurveHandle handle)
+{
+  return _curves[handle].segments;
+}
+
+const vector<Vector2> & CurveLibrary::samples(CurveHandle handle,
+                                              int num_samples)
+{
+  num_samples = max(num_samples, 2);
+  _Curve & entry = _curves[handle];
+  auto it = entry.samples.find(num_samples);
+  if (it != entry.samples.end()) return it->second;
+  
+  const auto & curve = entry.segments;
+  vector<Vector2> & samples = entry.samples[num_samples];
+  if (curve.size() < 2) return samples;
+  
+  const int num_segments = (int)curve.size() - 1;
+  for (int k = 0; k < num_samples; k++)
+  {
+    // where the sample falls along the curve, in segments
+    const double u = (double)k / (num_samples - 1) * num_segments;
+    const int i = min((int)u, num_segments - 1);
+    const FixedVector2 p = fixed_hermite(to_fixed(u - i),
+                                         curve[i],
+                                         curve[i+1]);
+    samples.push_back(to_vector2(p));
   }
+  return samples;
 }
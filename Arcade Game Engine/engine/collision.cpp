@@ -0,0 +1,1490 @@
+//
+//  collision.cpp
+//  Arcade Game Engine
+//
+
+#include <cmath>
+#include <limits>
+#include "collision.hpp"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define _USE_SSE2
+#endif
+
+// MARK: Helper functions
+
+inline long long _cellKey(int x, int y)
+{
+  return (long long)((unsigned long long)(unsigned int)x << 32 |
+                     (unsigned int)y);
+}
+
+const int _NULL_NODE = -1;
+
+// cells beyond this index in either direction are merged into the last one,
+// and bodies covering more cells than this are kept out of the cells
+const int _MAX_CELL = 1 << 20;
+const long long _MAX_PROXY_CELLS = 1024;
+
+// a tile grid grows to at most this many tiles, or as many per body
+const long long _MIN_TILES = 256;
+const long long _TILES_PER_BODY = 4;
+
+inline long long _pairKey(int a, int b)
+{
+  return _cellKey(a < b ? a : b, a < b ? b : a);
+}
+
+inline double _axisValue(Vector2 v, int axis)
+{
+  return axis == 0 ? v.x : v.y;
+}
+
+/**
+ *  Converts a number of tiles to an index, clamped so that it cannot overflow.
+ */
+inline int _tileIndex(double tiles, int min_index, int max_index)
+{
+  return (int)max((double)min_index, min((double)max_index, tiles));
+}
+
+/**
+ *  Divides two fixed-point numbers, clamping the quotient to the range.
+ */
+inline Fixed _clampedQuotient(Fixed l, Fixed r)
+{
+  const int64_t quotient = ((int64_t)l.raw << 16) / r.raw;
+  return {(int32_t)max((int64_t)INT32_MIN, min((int64_t)INT32_MAX, quotient))};
+}
+
+bool _clipSlab(double center,
+               double distance,
+               double min,
+               double max,
+               double & t_min,
+               double & t_max)
+{
+  if (distance == 0) return center >= min && center <= max;
+  
+  const double inverse_distance = 1.0 / distance;
+  double t1 = (min - center) * inverse_distance;
+  double t2 = (max - center) * inverse_distance;
+  if (t1 > t2) swap(t1, t2);
+  t_min = t_min > t1 ? t_min : t1;
+  t_max = t_max < t2 ? t_max : t2;
+  return t_min <= t_max;
+}
+
+// MARK: Free functions
+
+bool sweep_overlaps(AABB moving, Vector2 d, AABB obsticle)
+{
+  // grow the obsticle by the half extents of the moving box, and cast the
+  // center of the moving box along the distance
+  const Vector2 half_extents = (moving.max - moving.min) * 0.5;
+  const Vector2 center = (moving.min + moving.max) * 0.5;
+  const AABB grown {obsticle.min - half_extents, obsticle.max + half_extents};
+  
+  double t_min = 0;
+  double t_max = 1;
+  return _clipSlab(center.x, d.x, grown.min.x, grown.max.x, t_min, t_max) &&
+         _clipSlab(center.y, d.y, grown.min.y, grown.max.y, t_min, t_max);
+}
+
+bool sweep_aabb(AABB moving, Vector2 d, AABB obsticle, SweepHit & hit)
+{
+  const double infinity = numeric_limits<double>::infinity();
+  
+  // the times at which the boxes start and stop overlapping along each axis,
+  // where an axis without motion either always or never overlaps
+  auto slab = [infinity](double moving_min, double moving_max, double d,
+                         double obsticle_min, double obsticle_max,
+                         double & entry, double & exit)
+  {
+    const double inverse_d = 1.0 / d;
+    const double t1 = (obsticle_min - moving_max) * inverse_d;
+    const double t2 = (obsticle_max - moving_min) * inverse_d;
+    const bool overlapping = moving_max > obsticle_min &&
+                             moving_min < obsticle_max;
+    entry = d != 0 ? min(t1, t2) : (overlapping ? -infinity : infinity);
+    exit  = d != 0 ? max(t1, t2) : infinity;
+  };
+  
+  double entry_x, exit_x, entry_y, exit_y;
+  slab(moving.min.x, moving.max.x, d.x, obsticle.min.x, obsticle.max.x,
+       entry_x, exit_x);
+  slab(moving.min.y, moving.max.y, d.y, obsticle.min.y, obsticle.max.y,
+       entry_y, exit_y);
+  
+  const double entry = max(entry_x, entry_y);
+  const double exit  = min(exit_x, exit_y);
+  if (entry > exit || entry > 1 || exit <= 0) return false;
+  
+  if (entry >= 0)
+  {
+    // the face touched is on the axis that started overlapping last
+    const bool is_x = entry_x >= entry_y;
+    hit.time = entry;
+    hit.normal = is_x ? Vector2 {d.x > 0 ? -1.0 : 1.0, 0}
+                      : Vector2 {0, d.y > 0 ? -1.0 : 1.0};
+    hit.depth = 0;
+  }
+  else
+  {
+    // already overlapping, so separate along the axis that overlaps the least
+    const double left  = moving.max.x - obsticle.min.x;
+    const double right = obsticle.max.x - moving.min.x;
+    const double up    = moving.max.y - obsticle.min.y;
+    const double down  = obsticle.max.y - moving.min.y;
+    const double depth_x = min(left, right);
+    const double depth_y = min(up, down);
+    const bool is_x = depth_x < depth_y;
+    hit.time = 0;
+    hit.normal = is_x ? Vector2 {left < right ? -1.0 : 1.0, 0}
+                      : Vector2 {0, up < down ? -1.0 : 1.0};
+    hit.depth = is_x ? depth_x : depth_y;
+  }
+  return true;
+}
+
+bool sweep_aabb(FixedAABB moving,
+                FixedVector2 d,
+                FixedAABB obsticle,
+                FixedSweepHit & hit)
+{
+  const Fixed infinity {INT32_MAX};
+  const Fixed zero {0};
+  const Fixed one {FIXED_ONE};
+  
+  auto slab = [infinity](Fixed moving_min, Fixed moving_max, Fixed d,
+                         Fixed obsticle_min, Fixed obsticle_max,
+                         Fixed & entry, Fixed & exit)
+  {
+    if (d.raw == 0)
+    {
+      const bool overlapping = moving_max > obsticle_min &&
+                               moving_min < obsticle_max;
+      entry = overlapping ? -infinity : infinity;
+      exit  = infinity;
+      return;
+    }
+    const Fixed t1 = _clampedQuotient(obsticle_min - moving_max, d);
+    const Fixed t2 = _clampedQuotient(obsticle_max - moving_min, d);
+    entry = min(t1, t2);
+    exit  = max(t1, t2);
+  };
+  
+  Fixed entry_x, exit_x, entry_y, exit_y;
+  slab(moving.min.x, moving.max.x, d.x, obsticle.min.x, obsticle.max.x,
+       entry_x, exit_x);
+  slab(moving.min.y, moving.max.y, d.y, obsticle.min.y, obsticle.max.y,
+       entry_y, exit_y);
+  
+  const Fixed entry = max(entry_x, entry_y);
+  const Fixed exit  = min(exit_x, exit_y);
+  if (entry > exit || entry > one || exit <= zero) return false;
+  
+  if (entry >= zero)
+  {
+    const bool is_x = entry_x >= entry_y;
+    hit.time = entry;
+    hit.normal = is_x ? FixedVector2 {d.x > zero ? -one : one, zero}
+                      : FixedVector2 {zero, d.y > zero ? -one : one};
+    hit.depth = zero;
+  }
+  else
+  {
+    const Fixed left  = moving.max.x - obsticle.min.x;
+    const Fixed right = obsticle.max.x - moving.min.x;
+    const Fixed up    = moving.max.y - obsticle.min.y;
+    const Fixed down  = obsticle.max.y - moving.min.y;
+    const Fixed depth_x = min(left, right);
+    const Fixed depth_y = min(up, down);
+    const bool is_x = depth_x < depth_y;
+    hit.time = zero;
+    hit.normal = is_x ? FixedVector2 {left < right ? -one : one, zero}
+                      : FixedVector2 {zero, up < down ? -one : one};
+    hit.depth = is_x ? depth_x : depth_y;
+  }
+  return true;
+}
+
+
+//
+// MARK: - AABB arrays
+//
+
+// MARK: Member functions
+
+void AABBArray::set(size_t index, AABB b)
+{
+  min_x[index] = b.min.x;
+  min_y[index] = b.min.y;
+  max_x[index] = b.max.x;
+  max_y[index] = b.max.y;
+}
+
+void AABBArray::push_back(AABB b)
+{
+  min_x.push_back(b.min.x);
+  min_y.push_back(b.min.y);
+  max_x.push_back(b.max.x);
+  max_y.push_back(b.max.y);
+}
+
+void AABBArray::clear()
+{
+  min_x.clear();
+  min_y.clear();
+  max_x.clear();
+  max_y.clear();
+}
+
+// MARK: Free functions
+
+size_t find_overlaps(AABB area, const AABBArray & boxes, vector<int> & result)
+{
+  const size_t count = boxes.size();
+  const size_t start = result.size();
+  
+  // room for every box to overlap, so that indices can be written before
+  // knowing whether they are kept
+  result.resize(start + count);
+  int * hits = result.data() + start;
+  size_t num_hits = 0;
+  size_t i = 0;
+  
+#if defined(__AVX__)
+  const __m256d area_min_x = _mm256_set1_pd(area.min.x);
+  const __m256d area_min_y = _mm256_set1_pd(area.min.y);
+  const __m256d area_max_x = _mm256_set1_pd(area.max.x);
+  const __m256d area_max_y = _mm256_set1_pd(area.max.y);
+  for (; i + 4 <= count; i += 4)
+  {
+    const __m256d x = _mm256_and_pd(
+      _mm256_cmp_pd(area_min_x, _mm256_loadu_pd(&boxes.max_x[i]), _CMP_LE_OQ),
+      _mm256_cmp_pd(_mm256_loadu_pd(&boxes.min_x[i]), area_max_x, _CMP_LE_OQ));
+    const __m256d y = _mm256_and_pd(
+      _mm256_cmp_pd(area_min_y, _mm256_loadu_pd(&boxes.max_y[i]), _CMP_LE_OQ),
+      _mm256_cmp_pd(_mm256_loadu_pd(&boxes.min_y[i]), area_max_y, _CMP_LE_OQ));
+    const int mask = _mm256_movemask_pd(_mm256_and_pd(x, y));
+    for (int lane = 0; lane < 4; lane++)
+    {
+      hits[num_hits] = (int)i + lane;
+      num_hits += (mask >> lane) & 1;
+    }
+  }
+#elif defined(_USE_SSE2)
+  const __m128d area_min_x = _mm_set1_pd(area.min.x);
+  const __m128d area_min_y = _mm_set1_pd(area.min.y);
+  const __m128d area_max_x = _mm_set1_pd(area.max.x);
+  const __m128d area_max_y = _mm_set1_pd(area.max.y);
+  auto test = [&](size_t j)
+  {
+    const __m128d x = _mm_and_pd(
+      _mm_cmple_pd(area_min_x, _mm_loadu_pd(&boxes.max_x[j])),
+      _mm_cmple_pd(_mm_loadu_pd(&boxes.min_x[j]), area_max_x));
+    const __m128d y = _mm_and_pd(
+      _mm_cmple_pd(area_min_y, _mm_loadu_pd(&boxes.max_y[j])),
+      _mm_cmple_pd(_mm_loadu_pd(&boxes.min_y[j]), area_max_y));
+    return _mm_movemask_pd(_mm_and_pd(x, y));
+  };
+  for (; i + 4 <= count; i += 4)
+  {
+    const int mask = test(i) | test(i + 2) << 2;
+    for (int lane = 0; lane < 4; lane++)
+    {
+      hits[num_hits] = (int)i + lane;
+      num_hits += (mask >> lane) & 1;
+    }
+  }
+#endif
+  
+  for (; i < count; i++)
+  {
+    hits[num_hits] = (int)i;
+    num_hits += area.min.x <= boxes.max_x[i] && boxes.min_x[i] <= area.max.x &&
+                area.min.y <= boxes.max_y[i] && boxes.min_y[i] <= area.max.y;
+  }
+  
+  result.resize(start + num_hits);
+  return num_hits;
+}
+
+
+//
+// MARK: - Broadphase
+//
+
+// MARK: Member functions
+
+void Broadphase::querySwept(AABB bounds,
+                            Vector2 distance,
+                            CollisionLayer mask,
+                            vector<void*> & result) const
+{
+  query(sweep(bounds, distance), mask, result);
+}
+
+
+//
+// MARK: - BruteForce
+//
+
+// MARK: Member functions
+
+BroadphaseProxy BruteForce::insert(AABB bounds,
+                                   void * body,
+                                   CollisionFilter filter)
+{
+  if (_free_proxies.size() > 0)
+  {
+    BroadphaseProxy proxy = _free_proxies.back();
+    _free_proxies.pop_back();
+    _proxies[proxy] = {body, filter.layer};
+    _bounds.set(proxy, bounds);
+    return proxy;
+  }
+  _proxies.push_back({body, filter.layer});
+  _bounds.push_back(bounds);
+  return (BroadphaseProxy)_proxies.size() - 1;
+}
+
+void BruteForce::remove(BroadphaseProxy proxy)
+{
+  _proxies[proxy].body = nullptr;
+  _bounds.set(proxy, EMPTY_AABB);
+  _free_proxies.push_back(proxy);
+}
+
+void BruteForce::update(BroadphaseProxy proxy, AABB bounds)
+{
+  _bounds.set(proxy, bounds);
+}
+
+void BruteForce::query(AABB area,
+                       CollisionLayer mask,
+                       vector<void*> & result) const
+{
+  // each thread keeps its own indices, so that queries may run concurrently
+  static thread_local vector<int> hits;
+  hits.clear();
+  find_overlaps(area, _bounds, hits);
+  for (auto index : hits)
+  {
+    // removed bodies are left empty, which areas reaching infinitely far
+    // still overlap
+    const _Proxy & proxy = _proxies[index];
+    if (proxy.body && (proxy.layer & mask)) result.push_back(proxy.body);
+  }
+}
+
+void BruteForce::clear()
+{
+  _proxies.clear();
+  _free_proxies.clear();
+  _bounds.clear();
+}
+
+
+//
+// MARK: - SpatialHash
+//
+
+// MARK: Member functions
+
+SpatialHash::SpatialHash(double cell_size)
+  : _cell_size(cell_size)
+  , _inverse_cell_size(1.0 / cell_size)
+{}
+
+BroadphaseProxy SpatialHash::insert(AABB bounds,
+                                    void * body,
+                                    CollisionFilter filter)
+{
+  BroadphaseProxy proxy;
+  if (_free_proxies.size() > 0)
+  {
+    proxy = _free_proxies.back();
+    _free_proxies.pop_back();
+  }
+  else
+  {
+    proxy = (BroadphaseProxy)_proxies.size();
+    _proxies.push_back({});
+  }
+
+  const _CellRange cells = _cellRange(bounds);
+  _proxies[proxy] = {bounds, body, filter.layer, cells};
+  _addToCells(proxy, cells);
+  return proxy;
+}
+
+void SpatialHash::remove(BroadphaseProxy proxy)
+{
+  _removeFromCells(proxy, _proxies[proxy].cells);
+  _proxies[proxy].body = nullptr;
+  _free_proxies.push_back(proxy);
+}
+
+void SpatialHash::update(BroadphaseProxy proxy, AABB bounds)
+{
+  _Proxy & p = _proxies[proxy];
+  p.bounds = bounds;
+
+  // only rehash when the body has moved into other cells
+  const _CellRange cells = _cellRange(bounds);
+  if (cells.min_x != p.cells.min_x || cells.min_y != p.cells.min_y ||
+      cells.max_x != p.cells.max_x || cells.max_y != p.cells.max_y)
+  {
+    _removeFromCells(proxy, p.cells);
+    _addToCells(proxy, cells);
+    p.cells = cells;
+  }
+}
+
+void SpatialHash::query(AABB area,
+                        CollisionLayer mask,
+                        vector<void*> & result) const
+{
+  const _CellRange cells = _cellRange(area);
+  
+  // areas covering more cells than there are bodies are cheaper to test
+  // against every body
+  if (_numCells(cells) > (long long)_proxies.size())
+  {
+    for (auto & p : _proxies)
+    {
+      if (p.body && (p.layer & mask) && overlaps(area, p.bounds))
+      {
+        result.push_back(p.body);
+      }
+    }
+    return;
+  }
+  
+  for (auto proxy : _large_proxies)
+  {
+    const _Proxy & p = _proxies[proxy];
+    if ((p.layer & mask) && overlaps(area, p.bounds)) result.push_back(p.body);
+  }
+  
+  for (int y = cells.min_y; y <= cells.max_y; y++)
+  {
+    for (int x = cells.min_x; x <= cells.max_x; x++)
+    {
+      auto it = _cells.find(_cellKey(x, y));
+      if (it == _cells.end()) continue;
+
+      for (auto proxy : it->second)
+      {
+        // bodies spanning several cells are only reported from the first
+        // cell that they share with the area
+        const _Proxy & p = _proxies[proxy];
+        if (x == max(cells.min_x, p.cells.min_x) &&
+            y == max(cells.min_y, p.cells.min_y) &&
+            (p.layer & mask) && overlaps(area, p.bounds))
+        {
+          result.push_back(p.body);
+        }
+      }
+    }
+  }
+}
+
+void SpatialHash::clear()
+{
+  _proxies.clear();
+  _free_proxies.clear();
+  _large_proxies.clear();
+  _cells.clear();
+}
+
+void SpatialHash::cells(vector<AABB> & result) const
+{
+  for (auto & cell : _cells)
+  {
+    // cells that bodies have left are kept around, but not drawn
+    if (cell.second.empty()) continue;
+    
+    const int x = (int)(unsigned int)(cell.first >> 32);
+    const int y = (int)(unsigned int)cell.first;
+    const Vector2 min {x * _cell_size, y * _cell_size};
+    result.push_back({min, min + _cell_size});
+  }
+}
+
+// MARK: Private member functions
+
+SpatialHash::_CellRange SpatialHash::_cellRange(AABB bounds) const
+{
+  return
+  {
+    _cellIndex(bounds.min.x),
+    _cellIndex(bounds.min.y),
+    _cellIndex(bounds.max.x),
+    _cellIndex(bounds.max.y)
+  };
+}
+
+int SpatialHash::_cellIndex(double coordinate) const
+{
+  // coordinates far out, such as those of a body falling forever, would not
+  // fit an int, so they are kept to the last cell
+  const double index = floor(coordinate * _inverse_cell_size);
+  if (!(index > -_MAX_CELL)) return -_MAX_CELL;
+  if (index > _MAX_CELL) return _MAX_CELL;
+  return (int)index;
+}
+
+long long SpatialHash::_numCells(_CellRange cells) const
+{
+  return (long long)(cells.max_x - cells.min_x + 1) *
+         (long long)(cells.max_y - cells.min_y + 1);
+}
+
+void SpatialHash::_addToCells(BroadphaseProxy proxy, _CellRange cells)
+{
+  if (_numCells(cells) > _MAX_PROXY_CELLS)
+  {
+    _large_proxies.push_back(proxy);
+    return;
+  }
+  
+  for (int y = cells.min_y; y <= cells.max_y; y++)
+  {
+    for (int x = cells.min_x; x <= cells.max_x; x++)
+    {
+      _cells[_cellKey(x, y)].push_back(proxy);
+    }
+  }
+}
+
+void SpatialHash::_removeFromCells(BroadphaseProxy proxy, _CellRange cells)
+{
+  if (_numCells(cells) > _MAX_PROXY_CELLS)
+  {
+    _large_proxies.erase(std::remove(_large_proxies.begin(),
+                                     _large_proxies.end(),
+                                     proxy),
+                         _large_proxies.end());
+    return;
+  }
+  
+  for (int y = cells.min_y; y <= cells.max_y; y++)
+  {
+    for (int x = cells.min_x; x <= cells.max_x; x++)
+    {
+      auto & cell = _cells[_cellKey(x, y)];
+      for (size_t i = 0; i < cell.size(); i++)
+      {
+        if (cell[i] == proxy)
+        {
+          cell[i] = cell.back();
+          cell.pop_back();
+          break;
+        }
+      }
+    }
+  }
+}
+
+
+//
+// MARK: - AABBTree
+//
+
+// MARK: Member functions
+
+AABBTree::AABBTree(double margin)
+  : _margin(margin)
+  , _root(_NULL_NODE)
+  , _free_list(_NULL_NODE)
+{}
+
+BroadphaseProxy AABBTree::insert(AABB bounds,
+                                 void * body,
+                                 CollisionFilter filter)
+{
+  const int leaf = _allocateNode();
+  _Node & node = _nodes[leaf];
+  node.fat_bounds = expand(bounds, _margin);
+  node.bounds = bounds;
+  node.body = body;
+  node.layers = filter.layer;
+  node.height = 0;
+  _insertLeaf(leaf);
+  return leaf;
+}
+
+void AABBTree::remove(BroadphaseProxy proxy)
+{
+  _removeLeaf(proxy);
+  _freeNode(proxy);
+}
+
+void AABBTree::update(BroadphaseProxy proxy, AABB bounds)
+{
+  _nodes[proxy].bounds = bounds;
+  
+  // the tree is only restructured once the body leaves its fattened bounds
+  if (contains(_nodes[proxy].fat_bounds, bounds)) return;
+  
+  _removeLeaf(proxy);
+  _nodes[proxy].fat_bounds = expand(bounds, _margin);
+  _insertLeaf(proxy);
+}
+
+void AABBTree::query(AABB area,
+                     CollisionLayer mask,
+                     vector<void*> & result) const
+{
+  if (_root == _NULL_NODE) return;
+  
+  // each thread keeps its own stack, so that queries may run concurrently
+  static thread_local vector<int> stack;
+  stack.clear();
+  stack.push_back(_root);
+  while (stack.size() > 0)
+  {
+    const _Node & node = _nodes[stack.back()];
+    stack.pop_back();
+    
+    if (!(node.layers & mask) || !overlaps(area, node.fat_bounds)) continue;
+    
+    if (node.left == _NULL_NODE)
+    {
+      if (overlaps(area, node.bounds)) result.push_back(node.body);
+    }
+    else
+    {
+      stack.push_back(node.left);
+      stack.push_back(node.right);
+    }
+  }
+}
+
+void AABBTree::querySwept(AABB bounds,
+                          Vector2 distance,
+                          CollisionLayer mask,
+                          vector<void*> & result) const
+{
+  if (_root == _NULL_NODE) return;
+  
+  static thread_local vector<int> stack;
+  stack.clear();
+  stack.push_back(_root);
+  while (stack.size() > 0)
+  {
+    const _Node & node = _nodes[stack.back()];
+    stack.pop_back();
+    
+    if (!(node.layers & mask) ||
+        !sweep_overlaps(bounds, distance, node.fat_bounds)) continue;
+    
+    if (node.left == _NULL_NODE)
+    {
+      if (sweep_overlaps(bounds, distance, node.bounds))
+      {
+        result.push_back(node.body);
+      }
+    }
+    else
+    {
+      stack.push_back(node.left);
+      stack.push_back(node.right);
+    }
+  }
+}
+
+void AABBTree::clear()
+{
+  _nodes.clear();
+  _root = _NULL_NODE;
+  _free_list = _NULL_NODE;
+}
+
+void AABBTree::cells(vector<AABB> & result) const
+{
+  if (_root == _NULL_NODE) return;
+  
+  vector<int> stack {_root};
+  while (stack.size() > 0)
+  {
+    const _Node & node = _nodes[stack.back()];
+    stack.pop_back();
+    
+    result.push_back(node.fat_bounds);
+    if (node.left != _NULL_NODE)
+    {
+      stack.push_back(node.left);
+      stack.push_back(node.right);
+    }
+  }
+}
+
+int AABBTree::height()
+{
+  return _root == _NULL_NODE ? 0 : _nodes[_root].height;
+}
+
+// MARK: Private member functions
+
+int AABBTree::_allocateNode()
+{
+  int node;
+  if (_free_list != _NULL_NODE)
+  {
+    node = _free_list;
+    _free_list = _nodes[node].parent;
+  }
+  else
+  {
+    node = (int)_nodes.size();
+    _nodes.push_back({});
+  }
+  _nodes[node].body   = nullptr;
+  _nodes[node].parent = _NULL_NODE;
+  _nodes[node].left   = _NULL_NODE;
+  _nodes[node].right  = _NULL_NODE;
+  _nodes[node].height = 0;
+  return node;
+}
+
+void AABBTree::_freeNode(int node)
+{
+  // freed nodes are chained through their parent index
+  _nodes[node].parent = _free_list;
+  _nodes[node].height = -1;
+  _free_list = node;
+}
+
+void AABBTree::_insertLeaf(int leaf)
+{
+  if (_root == _NULL_NODE)
+  {
+    _root = leaf;
+    _nodes[leaf].parent = _NULL_NODE;
+    return;
+  }
+  
+  //// find the best sibling, by descending into the child that grows the
+  //// least in perimeter, until it is cheaper to pair up with the current node
+  const AABB leaf_bounds = _nodes[leaf].fat_bounds;
+  int index = _root;
+  while (_nodes[index].left != _NULL_NODE)
+  {
+    const _Node & node = _nodes[index];
+    const double node_perimeter = perimeter(node.fat_bounds);
+    const double combined_perimeter =
+      perimeter(merge(node.fat_bounds, leaf_bounds));
+    
+    // cost of creating a new parent for this node and the new leaf
+    const double cost = 2 * combined_perimeter;
+    
+    // minimum cost of pushing the leaf further down the tree
+    const double inheritance_cost = 2 * (combined_perimeter - node_perimeter);
+    
+    auto descend_cost = [this, leaf_bounds, inheritance_cost](int child)
+    {
+      const _Node & c = _nodes[child];
+      const double grown = perimeter(merge(leaf_bounds, c.fat_bounds));
+      return c.left == _NULL_NODE
+        ? grown + inheritance_cost
+        : grown - perimeter(c.fat_bounds) + inheritance_cost;
+    };
+    const double left_cost  = descend_cost(node.left);
+    const double right_cost = descend_cost(node.right);
+    
+    if (cost < left_cost && cost < right_cost) break;
+    index = left_cost < right_cost ? node.left : node.right;
+  }
+  const int sibling = index;
+  
+  //// create a new parent for the sibling and the leaf
+  const int old_parent = _nodes[sibling].parent;
+  const int new_parent = _allocateNode();
+  _nodes[new_parent].parent = old_parent;
+  _nodes[new_parent].fat_bounds = merge(leaf_bounds,
+                                        _nodes[sibling].fat_bounds);
+  _nodes[new_parent].layers = _nodes[leaf].layers | _nodes[sibling].layers;
+  _nodes[new_parent].height = _nodes[sibling].height + 1;
+  _nodes[new_parent].left = sibling;
+  _nodes[new_parent].right = leaf;
+  _nodes[sibling].parent = new_parent;
+  _nodes[leaf].parent = new_parent;
+  
+  if (old_parent == _NULL_NODE)
+  {
+    _root = new_parent;
+  }
+  else if (_nodes[old_parent].left == sibling)
+  {
+    _nodes[old_parent].left = new_parent;
+  }
+  else
+  {
+    _nodes[old_parent].right = new_parent;
+  }
+  
+  _refit(_nodes[leaf].parent);
+}
+
+void AABBTree::_removeLeaf(int leaf)
+{
+  if (leaf == _root)
+  {
+    _root = _NULL_NODE;
+    return;
+  }
+  
+  const int parent = _nodes[leaf].parent;
+  const int grand_parent = _nodes[parent].parent;
+  const int sibling = _nodes[parent].left == leaf
+    ? _nodes[parent].right
+    : _nodes[parent].left;
+  
+  // replace the parent with the sibling
+  if (grand_parent == _NULL_NODE)
+  {
+    _root = sibling;
+    _nodes[sibling].parent = _NULL_NODE;
+    _freeNode(parent);
+  }
+  else
+  {
+    if (_nodes[grand_parent].left == parent)
+    {
+      _nodes[grand_parent].left = sibling;
+    }
+    else
+    {
+      _nodes[grand_parent].right = sibling;
+    }
+    _nodes[sibling].parent = grand_parent;
+    _freeNode(parent);
+    _refit(grand_parent);
+  }
+}
+
+void AABBTree::_refit(int index)
+{
+  // walk back up the tree, balancing and fixing heights, bounds and layers
+  while (index != _NULL_NODE)
+  {
+    index = _balance(index);
+    
+    _Node & node = _nodes[index];
+    const _Node & left  = _nodes[node.left];
+    const _Node & right = _nodes[node.right];
+    node.height = 1 + max(left.height, right.height);
+    node.fat_bounds = merge(left.fat_bounds, right.fat_bounds);
+    node.layers = left.layers | right.layers;
+    
+    index = node.parent;
+  }
+}
+
+int AABBTree::_balance(int a)
+{
+  _Node & A = _nodes[a];
+  if (A.left == _NULL_NODE || A.height < 2) return a;
+  
+  const int b = A.left;
+  const int c = A.right;
+  _Node & B = _nodes[b];
+  _Node & C = _nodes[c];
+  const int balance = C.height - B.height;
+  
+  if (balance > 1)
+  {
+    //// rotate C up
+    const int f = C.left;
+    const int g = C.right;
+    _Node & F = _nodes[f];
+    _Node & G = _nodes[g];
+    
+    // swap A and C
+    C.left = a;
+    C.parent = A.parent;
+    A.parent = c;
+    
+    // make the old parent of A point to C
+    if (C.parent == _NULL_NODE)          _root = c;
+    else if (_nodes[C.parent].left == a) _nodes[C.parent].left = c;
+    else                                 _nodes[C.parent].right = c;
+    
+    // keep the higher of F and G under C
+    const int lower = F.height > G.height ? g : f;
+    const int higher = F.height > G.height ? f : g;
+    C.right = higher;
+    A.right = lower;
+    _nodes[lower].parent = a;
+    A.fat_bounds = merge(B.fat_bounds, _nodes[lower].fat_bounds);
+    C.fat_bounds = merge(A.fat_bounds, _nodes[higher].fat_bounds);
+    A.layers = B.layers | _nodes[lower].layers;
+    C.layers = A.layers | _nodes[higher].layers;
+    A.height = 1 + max(B.height, _nodes[lower].height);
+    C.height = 1 + max(A.height, _nodes[higher].height);
+    return c;
+  }
+  
+  if (balance < -1)
+  {
+    //// rotate B up
+    const int d = B.left;
+    const int e = B.right;
+    _Node & D = _nodes[d];
+    _Node & E = _nodes[e];
+    
+    // swap A and B
+    B.left = a;
+    B.parent = A.parent;
+    A.parent = b;
+    
+    // make the old parent of A point to B
+    if (B.parent == _NULL_NODE)          _root = b;
+    else if (_nodes[B.parent].left == a) _nodes[B.parent].left = b;
+    else                                 _nodes[B.parent].right = b;
+    
+    // keep the higher of D and E under B
+    const int lower = D.height > E.height ? e : d;
+    const int higher = D.height > E.height ? d : e;
+    B.right = higher;
+    A.left = lower;
+    _nodes[lower].parent = a;
+    A.fat_bounds = merge(C.fat_bounds, _nodes[lower].fat_bounds);
+    B.fat_bounds = merge(A.fat_bounds, _nodes[higher].fat_bounds);
+    A.layers = C.layers | _nodes[lower].layers;
+    B.layers = A.layers | _nodes[higher].layers;
+    A.height = 1 + max(C.height, _nodes[lower].height);
+    B.height = 1 + max(A.height, _nodes[higher].height);
+    return b;
+  }
+  
+  return a;
+}
+
+
+
+//
+// MARK: - SweepAndPrune
+//
+
+// MARK: Helper functions
+
+/**
+ *  Orders endpoints by value. Where a minimum and a maximum endpoint share the
+ *  same value, the minimum goes first, so that touching bounds overlap.
+ */
+template<class Endpoint>
+inline bool _precedes(const Endpoint & l, const Endpoint & r)
+{
+  return l.value < r.value || (l.value == r.value && !l.is_max && r.is_max);
+}
+
+// MARK: Member functions
+
+SweepAndPrune::SweepAndPrune()
+  : _num_lost_pairs(0),
+    _max_extents {0, 0}
+{}
+
+BroadphaseProxy SweepAndPrune::insert(AABB bounds,
+                                      void * body,
+                                      CollisionFilter filter)
+{
+  BroadphaseProxy proxy;
+  if (_free_proxies.size() > 0)
+  {
+    proxy = _free_proxies.back();
+    _free_proxies.pop_back();
+  }
+  else
+  {
+    proxy = (BroadphaseProxy)_proxies.size();
+    _proxies.push_back({});
+  }
+  _proxies[proxy].bounds = bounds;
+  _proxies[proxy].body = body;
+  _proxies[proxy].filter = filter;
+  _growExtents(bounds);
+  
+  // append the endpoints and sort them into place, without tracking pairs
+  // as they pass other endpoints on only one axis at a time
+  for (int axis = 0; axis < 2; axis++)
+  {
+    auto & endpoints = _endpoints[axis];
+    for (int is_max = 0; is_max < 2; is_max++)
+    {
+      _proxies[proxy].endpoints[axis][is_max] = (int)endpoints.size();
+      endpoints.push_back({0, proxy, is_max == 1});
+    }
+  }
+  _setEndpoints(proxy, bounds);
+  for (int axis = 0; axis < 2; axis++)
+  {
+    _sortDown(axis, _proxies[proxy].endpoints[axis][0], false);
+    _sortDown(axis, _proxies[proxy].endpoints[axis][1], false);
+  }
+  
+  // new bodies are rare, so their pairs are found by testing all others
+  for (BroadphaseProxy other = 0; other < (int)_proxies.size(); other++)
+  {
+    if (other != proxy && _proxies[other].body && _shouldPair(proxy, other))
+    {
+      _addPair(proxy, other);
+    }
+  }
+  
+  return proxy;
+}
+
+void SweepAndPrune::remove(BroadphaseProxy proxy)
+{
+  // move the endpoints past all others, so that they can be popped
+  const double end = numeric_limits<double>::max();
+  _setEndpoints(proxy, {{end, end}, {end, end}});
+  for (int axis = 0; axis < 2; axis++)
+  {
+    _sortUp(axis, _proxies[proxy].endpoints[axis][1], false);
+    _sortUp(axis, _proxies[proxy].endpoints[axis][0], false);
+    _endpoints[axis].pop_back();
+    _endpoints[axis].pop_back();
+  }
+  
+  for (auto & pair : _pairs)
+  {
+    if (pair.a == proxy || pair.b == proxy) _removePair(pair.a, pair.b);
+  }
+  
+  _proxies[proxy].body = nullptr;
+  _free_proxies.push_back(proxy);
+  
+  // bodies are removed rarely, so the extents are found again from the rest
+  _max_extents[0] = 0;
+  _max_extents[1] = 0;
+  for (auto & p : _proxies)
+  {
+    if (p.body) _growExtents(p.bounds);
+  }
+}
+
+void SweepAndPrune::update(BroadphaseProxy proxy, AABB bounds)
+{
+  _proxies[proxy].bounds = bounds;
+  _growExtents(bounds);
+  _setEndpoints(proxy, bounds);
+  
+  // growing endpoints are sorted first, so that the minimum and maximum
+  // endpoints of a body never have to pass each other
+  const int (&endpoints)[2][2] = _proxies[proxy].endpoints;
+  for (int axis = 0; axis < 2; axis++)
+  {
+    _sortDown(axis, endpoints[axis][0], true);
+    _sortUp  (axis, endpoints[axis][1], true);
+    _sortUp  (axis, endpoints[axis][0], true);
+    _sortDown(axis, endpoints[axis][1], true);
+  }
+}
+
+void SweepAndPrune::query(AABB area,
+                          CollisionLayer mask,
+                          vector<void*> & result) const
+{
+  // only bodies that start less than the largest extent before the area and
+  // no later than its end can overlap it, so the endpoints between those are
+  // found on both axes, and the shorter of the two runs is scanned
+  typedef vector<_Endpoint>::const_iterator Iterator;
+  Iterator first[2];
+  Iterator last[2];
+  for (int axis = 0; axis < 2; axis++)
+  {
+    const double extent = _max_extents[axis];
+    auto precedes_area = [extent](const _Endpoint & endpoint, double min)
+    {
+      return endpoint.value + extent < min;
+    };
+    auto follows_area = [](double max, const _Endpoint & endpoint)
+    {
+      return max < endpoint.value;
+    };
+    const auto & endpoints = _endpoints[axis];
+    first[axis] = lower_bound(endpoints.begin(),
+                              endpoints.end(),
+                              _axisValue(area.min, axis),
+                              precedes_area);
+    last[axis] = upper_bound(first[axis],
+                             endpoints.end(),
+                             _axisValue(area.max, axis),
+                             follows_area);
+  }
+  
+  const int axis = last[0] - first[0] <= last[1] - first[1] ? 0 : 1;
+  for (auto it = first[axis]; it != last[axis]; ++it)
+  {
+    const _Endpoint & endpoint = *it;
+    const _Proxy & p = _proxies[endpoint.proxy];
+    if (!endpoint.is_max && (p.filter.layer & mask) && overlaps(area, p.bounds))
+    {
+      result.push_back(p.body);
+    }
+  }
+}
+
+void SweepAndPrune::clear()
+{
+  _proxies.clear();
+  _free_proxies.clear();
+  _endpoints[0].clear();
+  _endpoints[1].clear();
+  _pairs.clear();
+  _pair_indices.clear();
+  _num_lost_pairs = 0;
+  _max_extents[0] = 0;
+  _max_extents[1] = 0;
+}
+
+void SweepAndPrune::pairs(vector<BroadphasePair> & result)
+{
+  // compact the pairs that have stopped overlapping, keeping the order of
+  // the others
+  if (_num_lost_pairs > 0)
+  {
+    auto lost = [](const _Pair & pair) { return pair.a == NULL_PROXY; };
+    _pairs.erase(remove_if(_pairs.begin(), _pairs.end(), lost), _pairs.end());
+    for (size_t i = 0; i < _pairs.size(); i++)
+    {
+      _pair_indices[_pairKey(_pairs[i].a, _pairs[i].b)] = i;
+    }
+    _num_lost_pairs = 0;
+  }
+  
+  for (auto & pair : _pairs)
+  {
+    result.push_back({_proxies[pair.a].body, _proxies[pair.b].body});
+  }
+}
+
+// MARK: Private member functions
+
+void SweepAndPrune::_setEndpoints(BroadphaseProxy proxy, AABB bounds)
+{
+  const _Proxy & p = _proxies[proxy];
+  for (int axis = 0; axis < 2; axis++)
+  {
+    _endpoints[axis][p.endpoints[axis][0]].value = _axisValue(bounds.min, axis);
+    _endpoints[axis][p.endpoints[axis][1]].value = _axisValue(bounds.max, axis);
+  }
+}
+
+void SweepAndPrune::_growExtents(AABB bounds)
+{
+  _max_extents[0] = max(_max_extents[0], bounds.max.x - bounds.min.x);
+  _max_extents[1] = max(_max_extents[1], bounds.max.y - bounds.min.y);
+}
+
+void SweepAndPrune::_sortDown(int axis, int index, bool update_pairs)
+{
+  auto & endpoints = _endpoints[axis];
+  const _Endpoint endpoint = endpoints[index];
+  while (index > 0 && _precedes(endpoint, endpoints[index - 1]))
+  {
+    const _Endpoint & previous = endpoints[index - 1];
+    if (update_pairs && endpoint.is_max != previous.is_max)
+    {
+      // a minimum passing a maximum downwards starts an overlap on this
+      // axis, and a maximum passing a minimum ends one
+      if (!endpoint.is_max)
+      {
+        if (_shouldPair(endpoint.proxy, previous.proxy))
+        {
+          _addPair(endpoint.proxy, previous.proxy);
+        }
+      }
+      else
+      {
+        _removePair(endpoint.proxy, previous.proxy);
+      }
+    }
+    _proxies[previous.proxy].endpoints[axis][previous.is_max] = index;
+    endpoints[index] = previous;
+    index -= 1;
+  }
+  _proxies[endpoint.proxy].endpoints[axis][endpoint.is_max] = index;
+  endpoints[index] = endpoint;
+}
+
+void SweepAndPrune::_sortUp(int axis, int index, bool update_pairs)
+{
+  auto & endpoints = _endpoints[axis];
+  const int last = (int)endpoints.size() - 1;
+  const _Endpoint endpoint = endpoints[index];
+  while (index < last && _precedes(endpoints[index + 1], endpoint))
+  {
+    const _Endpoint & next = endpoints[index + 1];
+    if (update_pairs && endpoint.is_max != next.is_max)
+    {
+      // a maximum passing a minimum upwards starts an overlap on this axis,
+      // and a minimum passing a maximum ends one
+      if (endpoint.is_max)
+      {
+        if (_shouldPair(endpoint.proxy, next.proxy))
+        {
+          _addPair(endpoint.proxy, next.proxy);
+        }
+      }
+      else
+      {
+        _removePair(endpoint.proxy, next.proxy);
+      }
+    }
+    _proxies[next.proxy].endpoints[axis][next.is_max] = index;
+    endpoints[index] = next;
+    index += 1;
+  }
+  _proxies[endpoint.proxy].endpoints[axis][endpoint.is_max] = index;
+  endpoints[index] = endpoint;
+}
+
+bool SweepAndPrune::_shouldPair(BroadphaseProxy a, BroadphaseProxy b)
+{
+  return should_collide(_proxies[a].filter, _proxies[b].filter) &&
+         overlaps(_proxies[a].bounds, _proxies[b].bounds);
+}
+
+void SweepAndPrune::_addPair(BroadphaseProxy a, BroadphaseProxy b)
+{
+  const long long key = _pairKey(a, b);
+  if (_pair_indices.count(key) > 0) return;
+  
+  _pair_indices[key] = _pairs.size();
+  _pairs.push_back({a < b ? a : b, a < b ? b : a});
+}
+
+void SweepAndPrune::_removePair(BroadphaseProxy a, BroadphaseProxy b)
+{
+  auto it = _pair_indices.find(_pairKey(a, b));
+  if (it == _pair_indices.end()) return;
+  
+  // lost pairs are only marked here, and compacted when the pairs are read
+  _pairs[it->second].a = NULL_PROXY;
+  _pair_indices.erase(it);
+  _num_lost_pairs += 1;
+}
+
+
+//
+// MARK: - TileGrid
+//
+
+// MARK: Member functions
+
+TileGrid::TileGrid(Vector2 origin, Vector2 row_offset, double tile_width)
+  : _origin(origin)
+  , _row_offset(row_offset)
+  , _tile_width(tile_width)
+  , _num_rows(0)
+  , _num_columns(0)
+  , _tile_extent({{0, 0}, {0, 0}})
+{}
+
+BroadphaseProxy TileGrid::insert(AABB bounds,
+                                 void * body,
+                                 CollisionFilter filter)
+{
+  BroadphaseProxy proxy;
+  if (_free_proxies.size() > 0)
+  {
+    proxy = _free_proxies.back();
+    _free_proxies.pop_back();
+  }
+  else
+  {
+    proxy = (BroadphaseProxy)_proxies.size();
+    _proxies.push_back({});
+  }
+  
+  _proxies[proxy] = {bounds, body, filter.layer, -1, -1};
+  _addToCell(proxy);
+  return proxy;
+}
+
+void TileGrid::remove(BroadphaseProxy proxy)
+{
+  _removeFromCell(proxy);
+  _proxies[proxy].body = nullptr;
+  _free_proxies.push_back(proxy);
+}
+
+void TileGrid::update(BroadphaseProxy proxy, AABB bounds)
+{
+  _removeFromCell(proxy);
+  _proxies[proxy].bounds = bounds;
+  _addToCell(proxy);
+}
+
+void TileGrid::query(AABB area,
+                     CollisionLayer mask,
+                     vector<void*> & result) const
+{
+  auto test = [this, area, mask, &result](BroadphaseProxy proxy)
+  {
+    const _Proxy & p = _proxies[proxy];
+    if ((p.layer & mask) && overlaps(area, p.bounds)) result.push_back(p.body);
+  };
+  
+  //// visit the tiles whose bodies can reach into the area, given how far
+  //// bodies extend from the origins of their tiles
+  const int min_row = _tileIndex(ceil((area.min.y - _origin.y -
+                                       _tile_extent.max.y) / _row_offset.y),
+                                 0, _num_rows);
+  const int max_row = _tileIndex(floor((area.max.y - _origin.y -
+                                        _tile_extent.min.y) / _row_offset.y),
+                                 -1, _num_rows - 1);
+  for (int row = min_row; row <= max_row; row++)
+  {
+    const double row_x = _origin.x + _row_offset.x * row;
+    const int min_column = _tileIndex(ceil((area.min.x - row_x -
+                                            _tile_extent.max.x) / _tile_width),
+                                      0, _num_columns);
+    const int max_column = _tileIndex(floor((area.max.x - row_x -
+                                             _tile_extent.min.x) / _tile_width),
+                                      -1, _num_columns - 1);
+    for (int column = min_column; column <= max_column; column++)
+    {
+      const BroadphaseProxy proxy = _cells[row * _num_columns + column];
+      if (proxy != NULL_PROXY) test(proxy);
+    }
+  }
+  
+  for (auto proxy : _outside) test(proxy);
+}
+
+void TileGrid::clear()
+{
+  _num_rows = 0;
+  _num_columns = 0;
+  _tile_extent = {{0, 0}, {0, 0}};
+  _proxies.clear();
+  _free_proxies.clear();
+  _cells.clear();
+  _outside.clear();
+}
+
+void TileGrid::cells(vector<AABB> & result) const
+{
+  for (int row = 0; row < _num_rows; row++)
+  {
+    for (int column = 0; column < _num_columns; column++)
+    {
+      if (_cells[row * _num_columns + column] == NULL_PROXY) continue;
+      
+      const Vector2 tile_origin =
+        _origin + _row_offset * row + Vector2 {_tile_width * column, 0};
+      result.push_back({tile_origin,
+                        tile_origin + Vector2 {_tile_width, _row_offset.y}});
+    }
+  }
+}
+
+bool TileGrid::tile(Vector2 position, int & row, int & column)
+{
+  row = _tileIndex(floor((position.y - _origin.y) / _row_offset.y),
+                   -1, max_tiles);
+  const double row_x = _origin.x + _row_offset.x * row;
+  column = _tileIndex(floor((position.x - row_x) / _tile_width),
+                      -1, max_tiles);
+  return row >= 0 && row < max_tiles && column >= 0 && column < max_tiles;
+}
+
+void * TileGrid::body(int row, int column)
+{
+  if (row < 0 || row >= _num_rows || column < 0 || column >= _num_columns)
+  {
+    return nullptr;
+  }
+  
+  const BroadphaseProxy proxy = _cells[row * _num_columns + column];
+  return proxy != NULL_PROXY ? _proxies[proxy].body : nullptr;
+}
+
+// MARK: Private member functions
+
+void TileGrid::_addToCell(BroadphaseProxy proxy)
+{
+  _Proxy & p = _proxies[proxy];
+  int row, column;
+  bool is_in_grid = tile((p.bounds.min + p.bounds.max) * 0.5, row, column);
+  if (is_in_grid && (row >= _num_rows || column >= _num_columns))
+  {
+    // the grid only grows while it stays dense, so that a body far out,
+    // such as one falling off the board, is kept aside instead
+    const int num_rows = max(row + 1, _num_rows);
+    const int num_columns = max(column + 1, _num_columns);
+    const long long num_bodies = _proxies.size() - _free_proxies.size();
+    is_in_grid = (long long)num_rows * num_columns <=
+                 max(_MIN_TILES, _TILES_PER_BODY * num_bodies);
+    if (is_in_grid) _resize(num_rows, num_columns);
+  }
+  
+  if (is_in_grid)
+  {
+    BroadphaseProxy & cell = _cells[row * _num_columns + column];
+    if (cell == NULL_PROXY)
+    {
+      cell = proxy;
+      p.row = row;
+      p.column = column;
+      
+      // widen the extent that bodies are known to reach from their tiles
+      const Vector2 tile_origin =
+        _origin + _row_offset * row + Vector2 {_tile_width * column, 0};
+      _tile_extent = merge(_tile_extent, {p.bounds.min - tile_origin,
+                                          p.bounds.max - tile_origin});
+      return;
+    }
+  }
+  
+  p.row = -1;
+  p.column = -1;
+  _outside.push_back(proxy);
+}
+
+void TileGrid::_removeFromCell(BroadphaseProxy proxy)
+{
+  _Proxy & p = _proxies[proxy];
+  if (p.row >= 0)
+  {
+    _cells[p.row * _num_columns + p.column] = NULL_PROXY;
+    return;
+  }
+  
+  for (size_t i = 0; i < _outside.size(); i++)
+  {
+    if (_outside[i] == proxy)
+    {
+      _outside[i] = _outside.back();
+      _outside.pop_back();
+      break;
+    }
+  }
+}
+
+void TileGrid::_resize(int num_rows, int num_columns)
+{
+  vector<BroadphaseProxy> cells(num_rows * num_columns, NULL_PROXY);
+  for (int row = 0; row < _num_rows; row++)
+  {
+    for (int column = 0; column < _num_columns; column++)
+    {
+      cells[row * num_columns + column] = _cells[row * _num_columns + column];
+    }
+  }
+  _cells.swap(cells);
+  _num_rows = num_rows;
+  _num_columns = num_columns;
+}
@@ -0,0 +1,603 @@
+//
+//  collision.hpp
+//  Arcade Game Engine
+//
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <limits>
+#include "types.hpp"
+
+using namespace std;
+
+
+//
+// MARK: - AABB
+//
+
+/**
+ *  Defines an axis-aligned bounding box by its minimum and maximum corners.
+ */
+struct AABB
+{
+  Vector2 min, max;
+};
+
+inline AABB make_aabb(Rectangle r) { return {r.pos, r.pos + r.dim}; }
+
+inline AABB make_aabb(Vector2 position, Rectangle r)
+{
+  return {position + r.pos, position + r.pos + r.dim};
+}
+
+/**
+ *  Checks if two boxes overlap. Boxes that merely touch are considered to
+ *  overlap, which keeps the broadphase conservative.
+ */
+inline bool overlaps(AABB l, AABB r)
+{
+  return l.min.x <= r.max.x && r.min.x <= l.max.x &&
+         l.min.y <= r.max.y && r.min.y <= l.max.y;
+}
+
+inline AABB merge(AABB l, AABB r)
+{
+  return {{min(l.min.x, r.min.x), min(l.min.y, r.min.y)},
+          {max(l.max.x, r.max.x), max(l.max.y, r.max.y)}};
+}
+
+inline AABB expand(AABB b, double margin)
+{
+  return {b.min - margin, b.max + margin};
+}
+
+/**
+ *  @return The box enclosing *b* both before and after it has travelled the
+ *          distance *d*.
+ */
+inline AABB sweep(AABB b, Vector2 d)
+{
+  return merge(b, {b.min + d, b.max + d});
+}
+
+/**
+ *  Defines an axis-aligned bounding box of fixed-point numbers.
+ */
+struct FixedAABB
+{
+  FixedVector2 min, max;
+};
+
+/**
+ *  @return The box in fixed point relative to an origin, which keeps boxes
+ *          near the origin within the fixed-point range.
+ */
+inline FixedAABB to_fixed(AABB b, Vector2 origin)
+{
+  return {to_fixed(b.min - origin), to_fixed(b.max - origin)};
+}
+
+inline bool contains(AABB outer, AABB inner)
+{
+  return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y &&
+         inner.max.x <= outer.max.x && inner.max.y <= outer.max.y;
+}
+
+inline double perimeter(AABB b)
+{
+  return 2 * ((b.max.x - b.min.x) + (b.max.y - b.min.y));
+}
+
+/**
+ *  Checks if a box travelling the distance *d* touches another box at some
+ *  point along the way, including at the very start.
+ */
+bool sweep_overlaps(AABB moving, Vector2 d, AABB obsticle);
+
+/**
+ *  Defines where a moving box first touches another box.
+ */
+struct SweepHit
+{
+  // the fraction of the distance travelled before touching, in [0, 1]
+  double time;
+  
+  // the direction of the face touched, pointing away from the other box
+  Vector2 normal;
+  
+  // how far the boxes already overlapped before travelling, along the normal
+  double depth;
+};
+
+/**
+ *  Finds when a box travelling the distance *d* first touches another box.
+ *  Boxes that merely touch at the start only collide if moving into each
+ *  other. Boxes that already overlap collide at time zero, with the normal and
+ *  depth of the smallest separation.
+ *
+ *  @return True if the boxes collide before the distance has been travelled.
+ */
+bool sweep_aabb(AABB moving, Vector2 d, AABB obsticle, SweepHit & hit);
+
+/**
+ *  Defines where a moving box first touches another box, in fixed point.
+ */
+struct FixedSweepHit
+{
+  Fixed time;
+  FixedVector2 normal;
+  Fixed depth;
+};
+
+/**
+ *  Finds when a box travelling the distance *d* first touches another box,
+ *  like *sweep_aabb* on doubles, in fixed-point arithmetic. Times beyond the
+ *  fixed-point range are clamped to it.
+ *
+ *  @return True if the boxes collide before the distance has been travelled.
+ */
+bool sweep_aabb(FixedAABB moving,
+                FixedVector2 d,
+                FixedAABB obsticle,
+                FixedSweepHit & hit);
+
+
+//
+// MARK: - AABB arrays
+//
+
+/**
+ *  Stores boxes as separate arrays of coordinates, so that several of them can
+ *  be tested against an area at once.
+ */
+struct AABBArray
+{
+  vector<double> min_x;
+  vector<double> min_y;
+  vector<double> max_x;
+  vector<double> max_y;
+  
+  size_t size() const { return min_x.size(); }
+  
+  AABB get(size_t index) const
+  {
+    return {{min_x[index], min_y[index]}, {max_x[index], max_y[index]}};
+  }
+  
+  void set(size_t index, AABB b);
+  void push_back(AABB b);
+  void clear();
+};
+
+/**
+ *  A box that never overlaps anything, for marking unused array entries.
+ */
+const AABB EMPTY_AABB
+{
+  { numeric_limits<double>::infinity(),  numeric_limits<double>::infinity()},
+  {-numeric_limits<double>::infinity(), -numeric_limits<double>::infinity()}
+};
+
+/**
+ *  Finds the boxes that overlap an area, such as the box enclosing a sweep.
+ *  The boxes are tested four at a time using AVX or SSE2 when the compiler
+ *  targets them, and one at a time otherwise.
+ *
+ *  @param  area    The area to test the boxes against.
+ *  @param  boxes   The boxes to test.
+ *  @param  result  The indices of the overlapping boxes will be appended
+ *                  here, in increasing order.
+ *  @return The number of overlapping boxes.
+ */
+size_t find_overlaps(AABB area, const AABBArray & boxes, vector<int> & result);
+
+
+//
+// MARK: - Collision filtering
+//
+
+/**
+ *  Collision layers are bit masks, where each bit is a separate layer. A body
+ *  is usually on a single layer, while the layers it collides with may be any
+ *  combination.
+ */
+typedef unsigned CollisionLayer;
+const CollisionLayer NO_LAYERS = 0;
+const CollisionLayer DEFAULT_LAYER = 1;
+const CollisionLayer ALL_LAYERS = ~0u;
+
+/**
+ *  Defines the layer a body is on and the layers it collides with.
+ */
+struct CollisionFilter
+{
+  CollisionLayer layer;
+  CollisionLayer mask;
+};
+
+/**
+ *  Checks if two bodies should be tested against each other, which they are
+ *  when either collides with the layer of the other.
+ */
+inline bool should_collide(CollisionFilter l, CollisionFilter r)
+{
+  return (l.layer & r.mask) != 0 || (r.layer & l.mask) != 0;
+}
+
+
+//
+// MARK: - Broadphase
+//
+
+typedef int BroadphaseProxy;
+const BroadphaseProxy NULL_PROXY = -1;
+
+/**
+ *  Defines a pair of bodies whose bounds overlap.
+ */
+struct BroadphasePair
+{
+  void * body_a;
+  void * body_b;
+};
+
+/**
+ *  Defines the interface of a broadphase, which keeps track of the bounds of
+ *  all collision bodies and quickly finds the bodies that might overlap a
+ *  given area, so that only those have to be tested precisely.
+ */
+class Broadphase
+{
+
+public:
+  virtual ~Broadphase() {};
+
+  /**
+   *  Adds a body to the broadphase.
+   *
+   *  @param  bounds  The world space bounds of the body.
+   *  @param  body    An opaque pointer that is handed back by queries.
+   *  @param  filter  The layer of the body, and the layers it collides with.
+   *  @return A proxy that identifies the body in the broadphase.
+   */
+  virtual BroadphaseProxy insert(AABB bounds,
+                                 void * body,
+                                 CollisionFilter filter) = 0;
+  virtual void remove(BroadphaseProxy proxy) = 0;
+  virtual void update(BroadphaseProxy proxy, AABB bounds) = 0;
+
+  /**
+   *  Finds the bodies whose bounds overlap an area. Each body is reported at
+   *  most once, in no particular order. Queries do not change the broadphase,
+   *  so several threads may query it at once, as long as no thread modifies
+   *  it meanwhile.
+   *
+   *  @param  area    The world space area to search.
+   *  @param  mask    Only bodies on any of these layers are reported.
+   *  @param  result  The bodies found will be appended here.
+   */
+  virtual void query(AABB area,
+                     CollisionLayer mask,
+                     vector<void*> & result) const = 0;
+
+  /**
+   *  Finds the bodies that a box touches while travelling a distance. The
+   *  default implementation queries the box enclosing the whole sweep, which
+   *  may report bodies that are only close to the path.
+   *
+   *  @param  bounds    The world space bounds of the box before travelling.
+   *  @param  distance  The distance travelled.
+   *  @param  mask      Only bodies on any of these layers are reported.
+   *  @param  result    The bodies found will be appended here.
+   */
+  virtual void querySwept(AABB bounds,
+                          Vector2 distance,
+                          CollisionLayer mask,
+                          vector<void*> & result) const;
+  virtual void clear() = 0;
+
+  /**
+   *  Finds the cells that the broadphase divides space into, such as the
+   *  occupied cells of a grid or the nodes of a tree, for drawing them when
+   *  debugging. The default implementation finds none.
+   *
+   *  @param  result  The world space bounds of the cells will be appended
+   *                  here.
+   */
+  virtual void cells(vector<AABB> &) const {}
+
+};
+
+
+//
+// MARK: - BruteForce
+//
+
+/**
+ *  Defines a broadphase that tests every body on each query. It scales poorly,
+ *  but serves as a reference for the other broadphases.
+ */
+class BruteForce
+  : public Broadphase
+{
+
+public:
+  BroadphaseProxy insert(AABB bounds, void * body, CollisionFilter filter);
+  void remove(BroadphaseProxy proxy);
+  void update(BroadphaseProxy proxy, AABB bounds);
+  void query(AABB area, CollisionLayer mask, vector<void*> & result) const;
+  void clear();
+
+private:
+  struct _Proxy
+  {
+    void * body;
+    CollisionLayer layer;
+  };
+
+  vector<_Proxy> _proxies;
+  vector<BroadphaseProxy> _free_proxies;
+  AABBArray _bounds;
+
+};
+
+
+//
+// MARK: - SpatialHash
+//
+
+/**
+ *  Defines a broadphase that hashes bodies into the cells of a uniform grid.
+ *  Suited for scenes where the bodies are of roughly the same size as a cell.
+ *  Bodies covering many cells are kept aside and tested by every query.
+ */
+class SpatialHash
+  : public Broadphase
+{
+
+public:
+  SpatialHash(double cell_size = 32);
+  BroadphaseProxy insert(AABB bounds, void * body, CollisionFilter filter);
+  void remove(BroadphaseProxy proxy);
+  void update(BroadphaseProxy proxy, AABB bounds);
+  void query(AABB area, CollisionLayer mask, vector<void*> & result) const;
+  void clear();
+  void cells(vector<AABB> & result) const;
+
+private:
+  struct _CellRange
+  {
+    int min_x, min_y, max_x, max_y;
+  };
+  struct _Proxy
+  {
+    AABB bounds;
+    void * body;
+    CollisionLayer layer;
+    _CellRange cells;
+  };
+
+  double _cell_size;
+  double _inverse_cell_size;
+  vector<_Proxy> _proxies;
+  vector<BroadphaseProxy> _free_proxies;
+  unordered_map<long long, vector<BroadphaseProxy>> _cells;
+  vector<BroadphaseProxy> _large_proxies;
+
+  _CellRange _cellRange(AABB bounds) const;
+  int _cellIndex(double coordinate) const;
+  long long _numCells(_CellRange cells) const;
+  void _addToCells(BroadphaseProxy proxy, _CellRange cells);
+  void _removeFromCells(BroadphaseProxy proxy, _CellRange cells);
+
+};
+
+
+//
+// MARK: - AABBTree
+//
+
+/**
+ *  Defines a broadphase that keeps the bodies in the leaves of a balanced
+ *  bounding volume hierarchy. The leaves are fattened by a margin, so that
+ *  bodies moving less than the margin do not have to be reinserted. Suited for
+ *  scenes with bodies of very different sizes.
+ */
+class AABBTree
+  : public Broadphase
+{
+
+public:
+  AABBTree(double margin = 4);
+  BroadphaseProxy insert(AABB bounds, void * body, CollisionFilter filter);
+  void remove(BroadphaseProxy proxy);
+  void update(BroadphaseProxy proxy, AABB bounds);
+  void query(AABB area, CollisionLayer mask, vector<void*> & result) const;
+  void querySwept(AABB bounds,
+                  Vector2 distance,
+                  CollisionLayer mask,
+                  vector<void*> & result) const;
+  void clear();
+  void cells(vector<AABB> & result) const;
+  int height();
+
+private:
+  struct _Node
+  {
+    AABB fat_bounds;
+    AABB bounds;
+    void * body;
+    CollisionLayer layers;
+    int parent;
+    int left;
+    int right;
+    int height;
+  };
+
+  double _margin;
+  vector<_Node> _nodes;
+  int _root;
+  int _free_list;
+
+  int _allocateNode();
+  void _freeNode(int node);
+  void _insertLeaf(int leaf);
+  void _removeLeaf(int leaf);
+  void _refit(int node);
+  int _balance(int node);
+
+};
+
+
+//
+// MARK: - SweepAndPrune
+//
+
+/**
+ *  Defines a broadphase that keeps the endpoints of all bounds sorted along
+ *  each axis. Since bodies move little between frames, the endpoint lists stay
+ *  nearly sorted and are kept in order with insertion sort. Whenever two
+ *  endpoints swap places, the overlap of their bodies may have changed, which
+ *  lets the set of overlapping pairs be maintained incrementally. Suited for
+ *  scenes where most bodies are at rest, and for reading out all pairs at
+ *  once; single queries scan the endpoints along one axis.
+ */
+class SweepAndPrune
+  : public Broadphase
+{
+
+public:
+  SweepAndPrune();
+  BroadphaseProxy insert(AABB bounds, void * body, CollisionFilter filter);
+  void remove(BroadphaseProxy proxy);
+  void update(BroadphaseProxy proxy, AABB bounds);
+  void query(AABB area, CollisionLayer mask, vector<void*> & result) const;
+  void clear();
+
+  /**
+   *  Finds all pairs of bodies whose bounds overlap, and where either body
+   *  collides with the layer of the other. The pairs are reported in the order
+   *  they started overlapping, so a pair keeps its place relative to the others
+   *  for as long as it lasts.
+   *
+   *  @param  result  The pairs will be appended here.
+   */
+  void pairs(vector<BroadphasePair> & result);
+
+private:
+  struct _Endpoint
+  {
+    double value;
+    BroadphaseProxy proxy;
+    bool is_max;
+  };
+  struct _Proxy
+  {
+    AABB bounds;
+    void * body;
+    CollisionFilter filter;
+    int endpoints[2][2];
+  };
+  struct _Pair
+  {
+    BroadphaseProxy a;
+    BroadphaseProxy b;
+  };
+
+  vector<_Proxy> _proxies;
+  vector<BroadphaseProxy> _free_proxies;
+  vector<_Endpoint> _endpoints[2];
+  vector<_Pair> _pairs;
+  unordered_map<long long, size_t> _pair_indices;
+  size_t _num_lost_pairs;
+  
+  // at least the largest extent of any body along each axis, so that
+  // queries can skip the bodies that start too far away to reach the area
+  double _max_extents[2];
+  
+  void _growExtents(AABB bounds);
+
+  void _setEndpoints(BroadphaseProxy proxy, AABB bounds);
+  void _sortDown(int axis, int index, bool update_pairs);
+  void _sortUp(int axis, int index, bool update_pairs);
+  bool _shouldPair(BroadphaseProxy a, BroadphaseProxy b);
+  void _addPair(BroadphaseProxy a, BroadphaseProxy b);
+  void _removePair(BroadphaseProxy a, BroadphaseProxy b);
+
+};
+
+
+//
+// MARK: - TileGrid
+//
+
+/**
+ *  Defines a broadphase for static bodies placed on a lattice of tiles, such
+ *  as the blocks of a board or the solid tiles of a tile map. Tile *row*,
+ *  *column* has its origin at
+ *
+ *    origin + row * row_offset + column * {tile_width, 0}
+ *
+ *  so rows may be shifted sideways to form staggered or pyramid layouts, and
+ *  the row offset must point downwards. A body is kept in the tile that the
+ *  center of its bounds is in, which lets positions be mapped to tiles and
+ *  areas to bodies in constant time. Bodies that share a tile with another
+ *  body, or whose tile is too far out for the grid to cover with at most
+ *  four tiles per body, are kept aside and tested on every query.
+ */
+class TileGrid
+  : public Broadphase
+{
+
+public:
+  static constexpr int max_tiles = 4096;
+
+  TileGrid(Vector2 origin, Vector2 row_offset, double tile_width);
+  BroadphaseProxy insert(AABB bounds, void * body, CollisionFilter filter);
+  void remove(BroadphaseProxy proxy);
+  void update(BroadphaseProxy proxy, AABB bounds);
+  void query(AABB area, CollisionLayer mask, vector<void*> & result) const;
+  void clear();
+  void cells(vector<AABB> & result) const;
+
+  /**
+   *  Finds the tile that a position is in.
+   *
+   *  @return True if the tile is within the rows and columns of the grid.
+   */
+  bool tile(Vector2 position, int & row, int & column);
+
+  /**
+   *  @return The body kept in a tile, or nullptr if the tile is empty.
+   */
+  void * body(int row, int column);
+
+private:
+  struct _Proxy
+  {
+    AABB bounds;
+    void * body;
+    CollisionLayer layer;
+    int row;
+    int column;
+  };
+
+  Vector2 _origin;
+  Vector2 _row_offset;
+  double _tile_width;
+  int _num_rows;
+  int _num_columns;
+  AABB _tile_extent;
+  vector<_Proxy> _proxies;
+  vector<BroadphaseProxy> _free_proxies;
+  vector<BroadphaseProxy> _cells;
+  vector<BroadphaseProxy> _outside;
+
+  void _addToCell(BroadphaseProxy proxy);
+  void _removeFromCell(BroadphaseProxy proxy);
+  void _resize(int num_rows, int num_columns);
+
+};
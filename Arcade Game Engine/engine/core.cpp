@@ -4,8 +4,9 @@
 //
 
 #include "core.hpp"
-#include <stack>
 #include <queue>
+#include <chrono>
+#include <algorithm>
 #ifdef __APPLE__
 # include <CoreFoundation/CoreFoundation.h>
 #endif
@@ -137,9 +138,50 @@ void SpriteCollection::draw(string id, int x, int y, int w, int h, int scale)
 
 void NotificationCenter::notify(Event event, GameObject & sender)
 {
-  for (auto pair : _instance()._blocks[event])
+  auto & center = _instance();
+  auto & blocks = center._blocks[event];
+  
+  EventStatistics * statistics = nullptr;
+  if (Profiler::main().enabled())
   {
-    if (pair.second == nullptr || pair.second == &sender) pair.first(event);
+    statistics = &center._statistics[event];
+    statistics->notifications += 1;
+    statistics->frame_notifications += 1;
+  }
+  
+  // observers added while notifying are not invoked until the next notify
+  const size_t count = blocks.size();
+  for (size_t i = 0; i < count; i++)
+  {
+    auto pair = blocks[i];
+    if (!pair.first) continue;
+    
+    if (pair.second == nullptr || pair.second == &sender)
+    {
+      if (statistics)
+      {
+        const double start_time = Profiler::now();
+        pair.first(event);
+        const double duration = Profiler::now() - start_time;
+        
+        statistics->observers_invoked += 1;
+        statistics->frame_observers_invoked += 1;
+        statistics->duration += duration;
+        statistics->frame_duration += duration;
+        if (i < statistics->observers.size())
+        {
+          // the sender is only known to be initialized once it notifies
+          auto & observer = statistics->observers[i];
+          if (observer.invocations == 0 && pair.second)
+          {
+            observer.label += " from " + sender.id();
+          }
+          observer.invocations += 1;
+          observer.duration += duration;
+        }
+      }
+      else pair.first(event);
+    }
   }
 }
 
@@ -147,19 +189,40 @@ ObserverID NotificationCenter::observe(function<void(Event)> block,
                                        Event event,
                                        GameObject * sender)
 {
-  auto size = _instance()._blocks[event].size();
-  _instance()._blocks[event].push_back({block, sender});
-  return hash<string>{}(event.string_value() + to_string(size));
+  // take the first spot emptied by unobserve, so that games that observe and
+  // unobserve over and over do not keep growing the blocks
+  auto & blocks_for_event = _instance()._blocks[event];
+  auto & observers = _instance()._statistics[event].observers;
+  size_t index = 0;
+  while (index < blocks_for_event.size() && blocks_for_event[index].first)
+  {
+    index++;
+  }
+  
+  string label = event.string_value() + " #" + to_string(index);
+  if (index < blocks_for_event.size())
+  {
+    blocks_for_event[index] = {block, sender};
+    observers[index] = {label, 0, 0};
+  }
+  else
+  {
+    blocks_for_event.push_back({block, sender});
+    observers.push_back({label, 0, 0});
+  }
+  
+  return hash<string>{}(event.string_value() + to_string(index));
 }
 
-// TODO: fix so that elements are not erased, but the spot it occupied is made
-// available for the next observer. This function is currently not in use.
+// the spot of the observer is emptied rather than erased, so that the ids and
+// statistics of the observers after it stay where they are, until the spot is
+// taken by a new observer
 void NotificationCenter::unobserve(ObserverID id,
                                    Event event,
                                    GameObject * sender)
 {
-  auto blocks_for_event = _instance()._blocks[event];
-  for (auto i = 0; i < blocks_for_event.size(); i++)
+  auto & blocks_for_event = _instance()._blocks[event];
+  for (size_t i = 0; i < blocks_for_event.size(); i++)
   {
     auto sender_for_block = blocks_for_event[i].second;
     if (sender_for_block == nullptr || sender == nullptr ||
@@ -168,13 +231,87 @@ void NotificationCenter::unobserve(ObserverID id,
       size_t h = hash<string>{}(event.string_value() + to_string(i));
       if (h == id)
       {
-        _instance()._blocks[event].erase(_instance()._blocks[event].begin()+i);
+        blocks_for_event[i] = {nullptr, nullptr};
         return;
       }
     }
   }
 }
 
+const map<Event, NotificationCenter::EventStatistics> &
+NotificationCenter::statistics()
+{
+  return _instance()._statistics;
+}
+
+void NotificationCenter::heaviestObservers(size_t n,
+                                           vector<ObserverStatistics> & result)
+{
+  result.clear();
+  for (auto & pair : _instance()._statistics)
+  {
+    for (auto & observer : pair.second.observers)
+    {
+      if (observer.invocations > 0) result.push_back(observer);
+    }
+  }
+  
+  auto heavier = [](const ObserverStatistics & l, const ObserverStatistics & r)
+  {
+    return l.duration > r.duration;
+  };
+  if (n < result.size())
+  {
+    partial_sort(result.begin(), result.begin()+n, result.end(), heavier);
+    result.resize(n);
+  }
+  else sort(result.begin(), result.end(), heavier);
+}
+
+void NotificationCenter::endFrameStatistics(long & notifications,
+                                            long & observers_invoked,
+                                            double & duration)
+{
+  notifications = 0;
+  observers_invoked = 0;
+  duration = 0;
+  
+  for (auto & pair : _instance()._statistics)
+  {
+    auto & statistics = pair.second;
+    notifications     += statistics.frame_notifications;
+    observers_invoked += statistics.frame_observers_invoked;
+    duration          += statistics.frame_duration;
+    
+    statistics.peak_notifications = max(statistics.peak_notifications,
+                                        statistics.frame_notifications);
+    statistics.peak_observers_invoked =
+      max(statistics.peak_observers_invoked,
+          statistics.frame_observers_invoked);
+    statistics.peak_duration = max(statistics.peak_duration,
+                                   statistics.frame_duration);
+    
+    statistics.frame_notifications = 0;
+    statistics.frame_observers_invoked = 0;
+    statistics.frame_duration = 0;
+  }
+}
+
+void NotificationCenter::resetStatistics()
+{
+  for (auto & pair : _instance()._statistics)
+  {
+    auto observers = pair.second.observers;
+    for (auto & observer : observers)
+    {
+      observer.invocations = 0;
+      observer.duration = 0;
+    }
+    pair.second = EventStatistics {};
+    pair.second.observers = observers;
+  }
+}
+
 // MARK: Private member functions
 
 NotificationCenter & NotificationCenter::_instance()
@@ -183,6 +320,170 @@ NotificationCenter & NotificationCenter::_instance()
   return instance;
 }
 
+
+//
+// MARK: - Profiler
+//
+
+// MARK: Helper functions
+
+static string _escapeJSON(const string & value)
+{
+  string result;
+  for (auto c : value)
+  {
+    if ((unsigned char)c < 0x20)
+    {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+      result += escaped;
+      continue;
+    }
+    if (c == '"' || c == '\\') result += '\\';
+    result += c;
+  }
+  return result;
+}
+
+// MARK: Member functions
+
+Profiler::Profiler()
+  : _next_frame(0)
+  , enabled(false)
+  , capacity(600)
+{}
+
+Profiler & Profiler::main()
+{
+  static Profiler instance;
+  return instance;
+}
+
+double Profiler::now()
+{
+  using namespace chrono;
+  auto time = steady_clock::now().time_since_epoch();
+  return duration_cast<duration<double>>(time).count();
+}
+
+void Profiler::beginFrame()
+{
+  _current_frame = Frame {};
+  _current_frame.start_time = now();
+}
+
+void Profiler::endFrame()
+{
+  if (!enabled()) return;
+  
+  _current_frame.duration = now() - _current_frame.start_time;
+  NotificationCenter::endFrameStatistics(_current_frame.notifications,
+                                         _current_frame.observers_invoked,
+                                         _current_frame.dispatch_duration);
+  
+  // keep the latest frames in a ring buffer
+  if (_frames.size() < capacity())
+  {
+    _frames.push_back(_current_frame);
+  }
+  else if (capacity() > 0)
+  {
+    _frames[_next_frame % _frames.size()] = _current_frame;
+  }
+  _next_frame += 1;
+}
+
+void Profiler::record(string section, double duration)
+{
+  if (enabled()) _current_frame.sections[section] += duration;
+}
+
+void Profiler::reset()
+{
+  _frames.clear();
+  _next_frame = 0;
+  NotificationCenter::resetStatistics();
+}
+
+bool Profiler::exportJSON(const char * filename, size_t top_n)
+{
+  FILE * file = fopen(filename, "w");
+  if (!file)
+  {
+    SDL_Log("Profiler: could not open %s for writing.\n", filename);
+    return false;
+  }
+  
+  // frames, oldest first
+  fprintf(file, "{\n  \"frames\": [");
+  const size_t first = _frames.size() < capacity() ? 0 : _next_frame;
+  for (size_t i = 0; i < _frames.size(); i++)
+  {
+    auto & frame = _frames[(first + i) % _frames.size()];
+    fprintf(file, "%s\n    {\"start_time\": %f, \"duration\": %.9f, ",
+            i > 0 ? "," : "",
+            frame.start_time,
+            frame.duration);
+    fprintf(file, "\"notifications\": %ld, \"observers_invoked\": %ld, ",
+            frame.notifications,
+            frame.observers_invoked);
+    fprintf(file, "\"dispatch_duration\": %.9f, \"sections\": {",
+            frame.dispatch_duration);
+    bool first_section = true;
+    for (auto & section : frame.sections)
+    {
+      fprintf(file, "%s\"%s\": %.9f",
+              first_section ? "" : ", ",
+              _escapeJSON(section.first).c_str(),
+              section.second);
+      first_section = false;
+    }
+    fprintf(file, "}}");
+  }
+  fprintf(file, "\n  ],\n");
+  
+  // dispatch statistics per event type
+  fprintf(file, "  \"events\": [");
+  bool first_event = true;
+  for (auto & pair : NotificationCenter::statistics())
+  {
+    Event event = pair.first;
+    auto & statistics = pair.second;
+    fprintf(file, "%s\n    {\"event\": \"%s\", \"observers\": %zu, ",
+            first_event ? "" : ",",
+            _escapeJSON(event.string_value()).c_str(),
+            statistics.observers.size());
+    fprintf(file, "\"notifications\": %ld, \"observers_invoked\": %ld, ",
+            statistics.notifications,
+            statistics.observers_invoked);
+    fprintf(file, "\"duration\": %.9f, \"peak_notifications\": %ld, ",
+            statistics.duration,
+            statistics.peak_notifications);
+    fprintf(file, "\"peak_observers_invoked\": %ld, \"peak_duration\": %.9f}",
+            statistics.peak_observers_invoked,
+            statistics.peak_duration);
+    first_event = false;
+  }
+  fprintf(file, "\n  ],\n");
+  
+  // heaviest observers
+  vector<NotificationCenter::ObserverStatistics> heaviest;
+  NotificationCenter::heaviestObservers(top_n, heaviest);
+  fprintf(file, "  \"heaviest_observers\": [");
+  for (size_t i = 0; i < heaviest.size(); i++)
+  {
+    fprintf(file, "%s\n    {\"observer\": \"%s\", \"invocations\": %ld, ",
+            i > 0 ? "," : "",
+            _escapeJSON(heaviest[i].label).c_str(),
+            heaviest[i].invocations);
+    fprintf(file, "\"duration\": %.9f}", heaviest[i].duration);
+  }
+  fprintf(file, "\n  ]\n}\n");
+  
+  fclose(file);
+  return true;
+}
+
 //
 // MARK: - Core
 //
@@ -190,11 +491,36 @@ NotificationCenter & NotificationCenter::_instance()
 // MARK: Member functions
 
 Core::Core()
-  : sample_rate(44100)
+  : _fixed_time(0)
+  , _body_stamp(0)
+  , _trigger_broadphase(new SpatialHash())
+  , _num_triggers(0)
+  , _num_pairs(0)
+  , _shows_stats(false)
+  , _work(nullptr)
+  , _work_count(0)
+  , _work_threads(0)
+  , _work_pending(0)
+  , _work_generation(0)
+  , _stops_workers(false)
+  , sample_rate(44100)
   , max_volume(0.05)
+  , broadphase(new SpatialHash())
+  , physics_stats({0, 0, 0, 0})
   , scale(1)
+  , physics_threads(0)
+  , physics_step(0)
+  , integrator(SEMI_IMPLICIT_EULER)
+  , fixed_delta_time(0)
+  , fixed_point(false)
+  , physics_debug(false)
 {}
 
+Core::~Core()
+{
+  _stopWorkers();
+}
+
 bool Core::init(Entity * root,
                 const char * title,
                 Dimension2 dimensions,
@@ -239,6 +565,7 @@ bool Core::init(Entity * root,
     ? SDL_WINDOWPOS_UNDEFINED 
     : dimensions.y);
   view_dimensions({dimensions.x, dimensions.y});
+  _title = title;
   window(SDL_CreateWindow(title,
                           w_pos_x,
                           w_pos_y,
@@ -331,6 +658,15 @@ void Core::destroy()
 {
   SpriteCollection::main().destroyAll();
   if (root()) root()->destroy();
+  _clearProxies();
+  for (auto & entry : _layer_broadphases) delete entry.second;
+  _layer_broadphases.clear();
+  delete broadphase();
+  broadphase(nullptr);
+  delete _trigger_broadphase;
+  _trigger_broadphase = nullptr;
+  for (auto compound : _compounds) delete compound;
+  _compounds.clear();
   
   SDL_CloseAudio();
   SDL_DestroyRenderer(renderer());
@@ -379,8 +715,13 @@ bool Core::update()
   
   // record time
   double start_time = elapsedTime();
-  delta_time(start_time - prev_time);
+  delta_time(fixed_delta_time() > 0 ? fixed_delta_time()
+                                    : start_time - prev_time);
   prev_time = start_time;
+  if (fixed_delta_time() > 0 && !_pause) _fixed_time += fixed_delta_time();
+  
+  Profiler & profiler = Profiler::main();
+  profiler.beginFrame();
   
 #ifdef GAME_ENGINE_DEBUG
   effectiveElapsedTime();
@@ -435,6 +776,9 @@ bool Core::update()
           if (!_pause) pause();
           else         resume();
           break;
+        case SDLK_b:
+          physics_debug(!physics_debug());
+          break;
 #endif
         case SDLK_ESCAPE:
         case SDLK_q:
@@ -448,60 +792,64 @@ bool Core::update()
   auto entities = vector<Entity*>();
   _buildEntityPriorityQueue(*root(), entities);
   
+  static const char * pass_names[5]
+  {
+    "graphics", "audio", "physics", "animation", "input"
+  };
+  
   uint8_t mask = !_pause ? 0b11111 : 0b00001;
-  for (uint8_t i = 0b10000; i > 0; i = i >>= 1)
+  int pass = 4;
+  double physics_start_time = 0;
+  for (uint8_t i = 0b10000; i > 0; i = i >>= 1, pass--)
   {
+    const double pass_start_time = profiler.enabled() ? Profiler::now() : 0;
+    if (mask & i & 0b00100)
+    {
+      physics_start_time = Profiler::now();
+      _num_pairs = 0;
+      _updateBroadphase();
+      _stagePhysics();
+    }
+    if (mask & i & 0b01000) _updateAnimations(entities);
+    if (mask & i & 0b00001) _updateFlipbooks(entities);
+    if (mask & i & 0b00001) _updateVisibility(entities);
     for (auto entity : entities)
     {
       entity->update(mask & i);
     }
-  }
-  
-#ifdef GAME_ENGINE_DEBUG
-  // draw bounding boxes
-  RGBAColor prev_color;
-  SDL_GetRenderDrawColor(renderer(),
-                         &prev_color.r,
-                         &prev_color.g,
-                         &prev_color.b,
-                         &prev_color.a);
-  SDL_SetRenderDrawColor(renderer(), 0xFF, 0xFF, 0xFF, 0xFF);
-  stack<Entity*> entity_stack;
-  entity_stack.push(root());
-  while (entity_stack.size() > 0)
-  {
-    Entity * current_entity = entity_stack.top();
-    entity_stack.pop();
-    
-    PhysicsComponent * current_physics_component;
-    if ((current_physics_component = current_entity->physics()))
+    if (mask & i & 0b00100)
     {
-      SDL_Rect rect;
-      Rectangle bounds = current_physics_component->collision_bounds();
-      Vector2 world_position;
-      current_entity->calculateWorldPosition(world_position);
-      rect.x = (world_position.x + bounds.pos.x) * scale();
-      rect.y = (world_position.y + bounds.pos.y) * scale();
-      rect.w = bounds.dim.x * scale();
-      rect.h = bounds.dim.y * scale();
-      SDL_RenderDrawRect(renderer(), &rect);
+      _solveContacts();
+      
+      size_t num_contacts = 0;
+      for (auto body : _bodies) num_contacts += body->_touching.size();
+      physics_stats({_bodies.size(),
+                     _num_pairs,
+                     num_contacts,
+                     Profiler::now() - physics_start_time});
     }
-    
-    for (auto child : current_entity->children())
+    if (profiler.enabled())
     {
-      entity_stack.push(child);
+      profiler.record(pass_names[pass], Profiler::now() - pass_start_time);
     }
   }
-  SDL_SetRenderDrawColor(renderer(),
-                         prev_color.r,
-                         prev_color.g,
-                         prev_color.b,
-                         prev_color.a);
-#endif
+  
+  // draw the physics on top of the frame
+  if (physics_debug()) _drawPhysicsDebug();
+  else if (_shows_stats)
+  {
+    SDL_SetWindowTitle(window(), _title.c_str());
+    _shows_stats = false;
+  }
   
   // clear screen
+  const double present_start_time = profiler.enabled() ? Profiler::now() : 0;
   SDL_RenderPresent(renderer());
   SDL_RenderClear(renderer());
+  if (profiler.enabled())
+  {
+    profiler.record("present", Profiler::now() - present_start_time);
+  }
   
   // possibly do a reset
   if (_reset)
@@ -527,6 +875,8 @@ bool Core::update()
     }
     else i++;
   }
+  
+  profiler.endFrame();
 
   return should_continue;
 }
@@ -546,6 +896,8 @@ double Core::elapsedTime()
 
 double Core::effectiveElapsedTime()
 {
+  if (fixed_delta_time() > 0) return _fixed_time;
+  
   static double last_pause_time;
   static double total_pause_duration;
   static bool pause_toggle;
@@ -595,6 +947,106 @@ double Core::effectiveElapsedTime()
   return (!_pause ? elapsed : last_pause_time) - total_pause_duration;
 }
 
+// MARK: Private member functions
+
+void Core::_updateFlipbooks(vector<Entity*> & entities)
+{
+  // flipbooks follow the clock rather than the game, so that they keep
+  // playing while it is paused
+  const double time = elapsedTime();
+  for (auto entity : entities)
+  {
+    GraphicsComponent * graphics = entity->graphics();
+    if (!entity->enabled() || !graphics || !graphics->_flipbook) continue;
+    
+    const Flipbook & flipbook = *graphics->_flipbook;
+    if (flipbook.frames.empty() || flipbook.duration <= 0) continue;
+    
+    // start over from the latest whole cycle, to keep the elapsed time small
+    const double elapsed = time - graphics->_flipbook_start_time;
+    double cycles;
+    modf(elapsed / flipbook.duration, &cycles);
+    graphics->_flipbook_start_time += cycles * flipbook.duration;
+    
+    const int num_frames = (int)flipbook.frames.size();
+    const int frame = (int)floor(fmod(elapsed, flipbook.duration) /
+                                 flipbook.duration * num_frames);
+    graphics->current_sprite(flipbook.frames[min(frame, num_frames - 1)]);
+  }
+}
+
+void Core::_updateVisibility(vector<Entity*> & entities)
+{
+  //// gather the bounds of the entities with graphics, and of what they draw
+  _bounded_entities.clear();
+  _view_bounds.clear();
+  _drawn_bounds.clear();
+  for (auto entity : entities)
+  {
+    if (!entity->enabled() || !entity->graphics()) continue;
+    
+    Vector2 world_position;
+    entity->calculateWorldPosition(world_position);
+    const Rectangle drawn = entity->graphics()->bounds();
+    _bounded_entities.push_back(entity);
+    _view_bounds.push_back({world_position,
+                            world_position + entity->dimensions()});
+    _drawn_bounds.push_back({world_position + drawn.pos,
+                             world_position + drawn.pos + drawn.dim});
+  }
+  
+  // entities starting at the far edges of the view are outside it, so the
+  // view ends just before them for the inclusive overlap test
+  const double lowest = -numeric_limits<double>::infinity();
+  const AABB view {{0, 0},
+                   {nextafter(view_dimensions().x, lowest),
+                    nextafter(view_dimensions().y, lowest)}};
+  
+  //// cull the graphics drawn outside of the view, even while paused, since
+  //// entities may still be enabled or moved
+  _in_view_indices.clear();
+  find_overlaps(view, _drawn_bounds, _in_view_indices);
+  size_t next_drawn = 0;
+  for (size_t i = 0; i < _bounded_entities.size(); i++)
+  {
+    const bool is_drawn = next_drawn < _in_view_indices.size() &&
+                          _in_view_indices[next_drawn] == (int)i;
+    if (is_drawn) next_drawn++;
+    _bounded_entities[i]->graphics()->_is_culled = !is_drawn;
+  }
+  
+  // the view events wait until the game resumes
+  if (_pause) return;
+  
+  _in_view_indices.clear();
+  find_overlaps(view, _view_bounds, _in_view_indices);
+  
+  //// record the changes before notifying anyone, since observers may move
+  //// or reset entities
+  _view_changes.clear();
+  size_t next_in_view = 0;
+  for (size_t i = 0; i < _bounded_entities.size(); i++)
+  {
+    const bool in_view = next_in_view < _in_view_indices.size() &&
+                         _in_view_indices[next_in_view] == (int)i;
+    if (in_view) next_in_view++;
+    
+    Entity * entity = _bounded_entities[i];
+    if (entity->in_view() != in_view)
+    {
+      entity->in_view() = in_view;
+      _view_changes.push_back({entity, in_view});
+    }
+  }
+  
+  for (auto change : _view_changes)
+  {
+    NotificationCenter::notify(change.second ? DidMoveIntoView
+                                             : DidMoveOutOfView,
+                               *change.first);
+  }
+}
+
 
 //
 // MARK: - Entity
@@ -620,6 +1072,8 @@ Entity::Entity(string id, int order)
   , graphics(nullptr)
   , order(order)
   , local_position({0, 0})
+  , in_view(false)
+  , compound(false)
 {}
 
 void Entity::addInput(InputComponent * input)
@@ -746,17 +1200,20 @@ void Entity::calculateWorldPosition(Vector2 & result)
 
 void Entity::moveTo(double x, double y)
 {
+  if (physics()) physics()->wake();
   local_position().x = x;
   local_position().y = y;
 }
 
 void Entity::moveHorizontallyTo(double x)
 {
+  if (physics()) physics()->wake();
   local_position().x = x;
 }
 
 void Entity::moveVerticallyTo(double y)
 {
+  if (physics()) physics()->wake();
   local_position().y = y;
 }
 
@@ -768,22 +1225,26 @@ void Entity::moveBy(double dx, double dy)
 
 void Entity::changeVelocityTo(double vx, double vy)
 {
+  if (physics()) physics()->wake();
   velocity().x = vx;
   velocity().y = vy;
 }
 
 void Entity::changeHorizontalVelocityTo(double vx)
 {
+  if (physics()) physics()->wake();
   velocity().x = vx;
 }
 
 void Entity::changeVerticalVelocityTo(double vy)
 {
+  if (physics()) physics()->wake();
   velocity().y = vy;
 }
 
 void Entity::changeVelocityBy(double dvx, double dvy)
 {
+  if (physics()) physics()->wake();
   velocity().x += dvx;
   velocity().y += dvy;
 }
@@ -840,6 +1301,12 @@ string GraphicsComponent::trait() { return "graphics"; }
 
 // MARK: Member functions
 
+GraphicsComponent::GraphicsComponent()
+  : _flipbook(nullptr)
+  , _flipbook_start_time(0)
+  , _is_culled(false)
+{}
+
 void GraphicsComponent::offsetTo(int x, int y)
 {
   bounds().pos.x = x;
@@ -864,9 +1331,24 @@ void GraphicsComponent::resizeBy(int dw, int dh)
   bounds().dim.y += dh;
 }
 
+void GraphicsComponent::playFlipbook(const Flipbook * flipbook)
+{
+  _flipbook = flipbook;
+  _flipbook_start_time = entity()->core()->elapsedTime();
+  if (flipbook && !flipbook->frames.empty())
+  {
+    current_sprite(flipbook->frames.front());
+  }
+}
+
+void GraphicsComponent::stopFlipbook()
+{
+  _flipbook = nullptr;
+}
+
 void GraphicsComponent::update(Core & world)
 {
-  if (current_sprite())
+  if (current_sprite() && !_is_culled)
   {
     Vector2 entity_pos;
     entity()->calculateWorldPosition(entity_pos);
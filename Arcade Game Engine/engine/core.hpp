@@ -6,10 +6,16 @@
 #pragma once
 
 #include <map>
+#include <deque>
 #include <vector>
 #include <string>
 #include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "types.hpp"
+#include "collision.hpp"
+#include "integration.hpp"
 
 #ifdef __APPLE__
 # include <SDL2/SDL.h>
@@ -26,6 +32,7 @@ using namespace std;
 class Sprite;
 class SpriteCollection;
 class NotificationCenter;
+class Profiler;
 class Timer;
 class Synthesizer;
 class Core;
@@ -43,6 +50,8 @@ class GraphicsComponent;
 const Event DidStartAnimating("DidStartAnimating");
 const Event DidStopAnimating("DidStopAnimating");
 const Event DidCollide("DidCollide");
+const Event DidStartColliding("DidStartColliding");
+const Event DidStopColliding("DidStopColliding");
 const Event DidMoveIntoView("DidMoveIntoView");
 const Event DidMoveOutOfView("DidMoveOutOfView");
 
@@ -93,6 +102,22 @@ public:
 };
 
 
+//
+// MARK: - Flipbook
+//
+
+/**
+ *  Defines a looping sequence of sprites that are shown in turn, each for an
+ *  equal share of the duration. The sprites are retrieved once when the
+ *  flipbook is made, so that playing it involves no lookups.
+ */
+struct Flipbook
+{
+  vector<Sprite*> frames;
+  double duration;
+};
+
+
 //
 // MARK: - NotificationCenter
 //
@@ -101,7 +126,41 @@ typedef size_t ObserverID;
 
 class NotificationCenter
 {
+public:
+  /**
+   *  Defines the dispatch statistics gathered for a single observer while the
+   *  main profiler is enabled.
+   */
+  struct ObserverStatistics
+  {
+    string label;
+    long invocations;
+    double duration;
+  };
+  
+  /**
+   *  Defines the dispatch statistics gathered for an event type while the main
+   *  profiler is enabled. The frame_* members are cleared at the end of each
+   *  frame, after the peak_* members have been updated from them. Durations
+   *  include the time of any notifications dispatched by the handlers.
+   */
+  struct EventStatistics
+  {
+    long notifications;
+    long observers_invoked;
+    double duration;
+    long frame_notifications;
+    long frame_observers_invoked;
+    double frame_duration;
+    long peak_notifications;
+    long peak_observers_invoked;
+    double peak_duration;
+    vector<ObserverStatistics> observers;
+  };
+  
+private:
   map<Event, vector<pair<function<void(Event)>, GameObject*>>> _blocks;
+  map<Event, EventStatistics> _statistics;
   
   NotificationCenter() {};
   static NotificationCenter & _instance();
@@ -113,6 +172,87 @@ public:
   static void unobserve(ObserverID id,
                         Event event,
                         GameObject * sender = nullptr);
+  
+  static const map<Event, EventStatistics> & statistics();
+  
+  /**
+   *  Collects the observers with the largest accumulated handler time.
+   *
+   *  @param  n       The maximum number of observers to collect.
+   *  @param  result  The observers, heaviest first, will be stored here.
+   */
+  static void heaviestObservers(size_t n, vector<ObserverStatistics> & result);
+  
+  /**
+   *  Ends the current frame of statistics, and sums up what was dispatched
+   *  during it over all event types.
+   */
+  static void endFrameStatistics(long & notifications,
+                                 long & observers_invoked,
+                                 double & duration);
+  static void resetStatistics();
+};
+
+
+//
+// MARK: - Profiler
+//
+
+/**
+ *  Defines a frame profiler, which records the time spent in each phase of a
+ *  frame and exports it together with the event dispatch statistics.
+ */
+class Profiler
+{
+public:
+  /**
+   *  Defines the measurements recorded during a single frame.
+   */
+  struct Frame
+  {
+    double start_time;
+    double duration;
+    map<string, double> sections;
+    long notifications;
+    long observers_invoked;
+    double dispatch_duration;
+  };
+  
+private:
+  vector<Frame> _frames;
+  size_t _next_frame;
+  Frame _current_frame;
+  
+  Profiler();
+public:
+  prop<bool>   enabled;
+  prop<size_t> capacity;
+  
+  Profiler(Profiler const &) = delete;
+  static Profiler & main();
+  
+  /**
+   *  @return A monotonic time stamp in seconds, suited for measuring short
+   *          durations.
+   */
+  static double now();
+  
+  void beginFrame();
+  void endFrame();
+  void record(string section, double duration);
+  void reset();
+  
+  /**
+   *  Writes the recorded frames, the dispatch statistics per event type and
+   *  the heaviest observers to a JSON file.
+   *
+   *  @param  filename  The file to write to.
+   *  @param  top_n     The number of heaviest observers to include.
+   *  @return true on success, false if the file could not be written.
+   */
+  bool exportJSON(const char * filename, size_t top_n = 10);
+  
+  void operator=(Profiler const &) = delete;
 };
 
 
@@ -193,6 +333,59 @@ private:
 };
 
 
+//
+// MARK: - Hermite arrays
+//
+
+/**
+ *  Stores segments of cubic Hermite curves, how far along each segment to
+ *  evaluate it and an offset to add to each result, as separate arrays of
+ *  coordinates, so that several segments can be evaluated at once.
+ */
+struct HermiteArray
+{
+  // how far along each segment to evaluate it, in [0, 1]
+  vector<double> t;
+  
+  vector<double> offset_x;
+  vector<double> offset_y;
+  
+  // the points and velocities at the start and end of each segment
+  vector<double> p0_x;
+  vector<double> p0_y;
+  vector<double> m0_x;
+  vector<double> m0_y;
+  vector<double> p1_x;
+  vector<double> p1_y;
+  vector<double> m1_x;
+  vector<double> m1_y;
+  
+  // the offset points on the segments, once evaluated
+  vector<double> result_x;
+  vector<double> result_y;
+  
+  size_t size() const { return t.size(); }
+  
+  Vector2 result(size_t index) const
+  {
+    return {result_x[index], result_y[index]};
+  }
+  
+  void push_back(double t,
+                 Vector2 offset,
+                 pair<Vector2, Vector2> s0,
+                 pair<Vector2, Vector2> s1);
+  void clear();
+};
+
+/**
+ *  Evaluates every segment of an array, and stores the results in it. The
+ *  segments are evaluated four at a time using AVX, two at a time using SSE2,
+ *  and one at a time otherwise, with the same results.
+ */
+void evaluate_hermite(HermiteArray & segments);
+
+
 //
 // MARK: - Core
 //
@@ -211,6 +404,41 @@ public:
   {
     bool up, down, left, right;
   };
+  
+  /**
+   *  Defines where a ray first hits a body.
+   */
+  struct RaycastHit
+  {
+    Entity * entity;
+    
+    // where the ray hits, in world space
+    Vector2 position;
+    
+    // the direction of the face hit, pointing away from the body
+    Vector2 normal;
+    
+    // the fraction of the ray travelled before hitting, in [0, 1]
+    double time;
+  };
+  
+  /**
+   *  Defines the counters of the last physics phase.
+   */
+  struct PhysicsStats
+  {
+    // the bodies in the tree, including triggers and sleeping bodies
+    size_t bodies;
+    
+    // the pairs of bodies found by the broadphase and tested precisely
+    size_t pairs;
+    
+    // the entities that bodies touch, counted once by each body
+    size_t contacts;
+    
+    // the time spent in the physics phase, in seconds
+    double duration;
+  };
 private:
   struct _Timer
   {
@@ -221,9 +449,117 @@ private:
   
   KeyStatus _key_status;
   vector<pair<_Timer, _TimerType>> _timers;
+  
+  struct _DynamicContact
+  {
+    PhysicsComponent * a;
+    PhysicsComponent * b;
+    
+    // the normal of the face of b that a hit
+    Vector2 normal;
+  };
+  struct _Compound
+  {
+    Entity * entity;
+    
+    // the bodies of the subtree, other than triggers
+    BruteForce bodies;
+    AABB bounds;
+    CollisionLayer layers;
+    unsigned stamp;
+  };
+  
   double _pause_duration;
+  double _fixed_time;
   bool _reset;
   bool _pause;
+  vector<PhysicsComponent*> _bodies;
+  vector<PhysicsComponent*> _previous_bodies;
+  vector<void*> _candidates;
+  vector<AABB> _obsticle_bounds;
+  vector<Vector2> _obsticle_motions;
+  vector<PhysicsComponent*> _staged_bodies;
+  unsigned _body_stamp;
+  vector<pair<CollisionLayer, Broadphase*>> _layer_broadphases;
+  Broadphase * _trigger_broadphase;
+  unsigned _num_triggers;
+  vector<_Compound*> _compounds;
+  vector<_DynamicContact> _dynamic_contacts;
+  vector<Entity*> _bounded_entities;
+  AABBArray _view_bounds;
+  AABBArray _drawn_bounds;
+  vector<int> _in_view_indices;
+  vector<pair<Entity*, bool>> _view_changes;
+  HermiteArray _animation_segments;
+  vector<AnimationComponent*> _sampled_animations;
+  vector<AnimationComponent*> _stopped_animations;
+  size_t _num_pairs;
+  vector<AABB> _debug_boxes;
+  vector<SDL_Rect> _debug_rects;
+  string _title;
+  bool _shows_stats;
+  
+  // the physics threads other than the main one, which wait for work between
+  // calls to _parallelFor
+  vector<thread> _workers;
+  mutex _work_mutex;
+  condition_variable _work_ready;
+  condition_variable _work_done;
+  const function<void(size_t)> * _work;
+  size_t _work_count;
+  size_t _work_threads;
+  size_t _work_pending;
+  unsigned _work_generation;
+  bool _stops_workers;
+  
+  void _updateVisibility(vector<Entity*> & entities);
+  void _updateAnimations(vector<Entity*> & entities);
+  void _updateFlipbooks(vector<Entity*> & entities);
+  Broadphase * _broadphaseFor(PhysicsComponent * body);
+  void _collectBodies(Entity & entity,
+                      Vector2 parent_position,
+                      _Compound * compound,
+                      vector<pair<PhysicsComponent*, Vector2>> & result);
+  _Compound * _compoundFor(Entity & entity);
+  void _updateBroadphase();
+  void _removeBody(PhysicsComponent * body);
+  void _clearProxies();
+  void _queryBodies(AABB area, CollisionLayer mask, vector<void*> & result);
+  void _queryCandidates(PhysicsComponent * physics,
+                        AABB bounds,
+                        Vector2 travel_distance,
+                        vector<void*> & result);
+  void _sweep(PhysicsComponent * physics,
+              AABB bounds,
+              Vector2 & travel_distance,
+              Vector2 & velocity,
+              bool collision_response,
+              const vector<void*> & candidates,
+              const vector<AABB> & obsticle_bounds,
+              const vector<Vector2> & obsticle_motions,
+              vector<Entity*> & result,
+              vector<_DynamicContact> & contacts);
+  void _sweepFixed(PhysicsComponent * physics,
+                   AABB bounds,
+                   Vector2 & travel_distance,
+                   Vector2 & velocity,
+                   bool collision_response,
+                   const vector<void*> & candidates,
+                   const vector<AABB> & obsticle_bounds,
+                   const vector<Vector2> & obsticle_motions,
+                   vector<Entity*> & result,
+                   vector<_DynamicContact> & contacts) const;
+  void _stagePhysics();
+  void _parallelFor(size_t count, function<void(size_t)> block);
+  void _runWorker(size_t index, unsigned generation);
+  void _runWork(size_t index);
+  void _stopWorkers();
+  void _solveContacts();
+  void _solveContact(const _DynamicContact & contact);
+  void _solveContactFixed(const _DynamicContact & contact);
+  void _drawPhysicsDebug();
+  
+  friend PhysicsComponent;
 public:
   prop_r<Core, SDL_Window*>   window;
   prop_r<Core, SDL_Renderer*> renderer;
@@ -232,9 +568,61 @@ public:
   prop_r<Core, Dimension2>    view_dimensions;
   prop_r<Core, int>           sample_rate;
   prop_r<Core, double>        max_volume;
+  prop_r<Core, Broadphase*>   broadphase;
+  prop_r<Core, PhysicsStats>  physics_stats;
   prop<int>                   scale;
   
+  /**
+   *  The number of threads that the bodies are integrated and swept on, where
+   *  0, the default, and 1 use the calling thread only. The results are the
+   *  same for any number of threads.
+   */
+  prop<int>                   physics_threads;
+  
+  /**
+   *  The longest duration, in seconds, that moving bodies integrate their
+   *  velocity and are swept for collisions over in one go. Longer frames are
+   *  split into sub-steps of at most this duration, up to the cap of each
+   *  body. When 0, which is the default, each frame is a single step.
+   */
+  prop<double>                physics_step;
+  
+  /**
+   *  How the bodies integrate their velocity and gravity, which is
+   *  SEMI_IMPLICIT_EULER by default. VELOCITY_VERLET costs the same, but
+   *  keeps fast falls on the exact path whatever the frame rate.
+   */
+  prop<Integrator>            integrator;
+  
+  /**
+   *  The duration, in seconds, that every frame advances the game by, or 0
+   *  to advance it by the time since the previous frame, which is the
+   *  default.
+   *
+   *  When set, the effective elapsed time only advances by whole frames.
+   *  Accumulative timers still follow the clock.
+   */
+  prop<double>                fixed_delta_time;
+  
+  /**
+   *  Whether bodies and animations move in 16.16 fixed point, which is off by
+   *  default. With a fixed_delta_time, the same input then plays out the same
+   *  on any machine. Velocities, and the distances between bodies that may
+   *  collide, must stay below 32768 pixels.
+   */
+  prop<bool>                  fixed_point;
+  
+  /**
+   *  Whether to draw the physics on top of each frame, which is off by
+   *  default. The cells of the broadphases and the bounds of compounds are
+   *  drawn in grey, the bounds of bodies in white, the boxes swept by moving
+   *  bodies in yellow, and where bodies touch in red. The physics stats are
+   *  shown in the window title meanwhile.
+   */
+  prop<bool>                  physics_debug;
+  
   Core();
+  ~Core();
   bool init(Entity * root,
             const char * title,
             Dimension2 dimensions,
@@ -243,6 +631,32 @@ public:
   void reset(double after_duration = 0);
   void pause();
   void resume();
+  
+  /**
+   *  Replaces the broadphase used for collision detection of bodies on layers
+   *  without a broadphase of their own. Bodies are moved over to the new
+   *  broadphase at the start of the next physics phase. Triggers are always
+   *  kept in a broadphase of their own, and the bodies of compound entities
+   *  are kept with their compound.
+   *
+   *  @param  broadphase  The broadphase to use, which must be constructed
+   *                      using the new operator. It will be deleted either by
+   *                      replacing it, or by calling *destroy*.
+   */
+  void useBroadphase(Broadphase * broadphase);
+  
+  /**
+   *  Keeps the bodies on some layers in a broadphase of their own, such as a
+   *  tile grid for the static bodies of a level. Collision detection only
+   *  searches it when looking for bodies on those layers.
+   *
+   *  @param  broadphase  The broadphase to use, which must be constructed
+   *                      using the new operator. It will be deleted either by
+   *                      replacing it for the same layers, or by calling
+   *                      *destroy*.
+   *  @param  layers      The layers of the bodies to keep in the broadphase.
+   */
+  void useBroadphase(Broadphase * broadphase, CollisionLayer layers);
   void createEffectiveTimer(double duration, function<void()> block);
   void createAccumulativeTimer(double duration, function<void()> block);
   bool update();
@@ -250,13 +664,29 @@ public:
   /**
    *  Collision detection for AABB.
    *
-   *  Note: obsticles are assumed static in the calculations.
+   *  Only the obsticles that the broadphase finds within the area swept by the
+   *  collider, and on the layers it collides with, are tested. The broadphase
+   *  is updated at the start of every physics phase, and whenever a body moves
+   *  during it.
+   *
+   *  When responding, the collider is moved up to the first obsticle hit, and
+   *  then slides along it for the rest of the distance, losing velocity by its
+   *  friction.
+   *
+   *  Dynamic obsticles that are yet to move during the physics phase are
+   *  swept against by the motion relative to them. Rather than pushing the
+   *  collider out of them, the collision is kept as a contact, and at the end
+   *  of the physics phase the bodies of all contacts are separated and their
+   *  velocities along the contact normals evened out, weighted by their
+   *  masses.
    *
    *  @param  collider            The dynamic entity to detect collision for.
    *  @param  travel_distance     The distance the entity will travel until the
-   *                              next frame.
+   *                              next frame. Updated with the distance it can
+   *                              travel when responding.
    *  @param  collision_response  Specifies whether the collider should respond
-   *                              to the collision or not.
+   *                              to the collision or not. Even so, it only
+   *                              responds to the layers it is set to.
    *  @param  result              The entities that the collider has collided 
    *                              with will be stored here.
    */
@@ -264,6 +694,53 @@ public:
                          Vector2 & new_position,
                          bool collision_response,
                          vector<Entity*> & result);
+  
+  /**
+   *  Finds the entities whose collision bounds contain a point, in the order
+   *  they are in the entity tree.
+   *
+   *  The spatial queries search the broadphases, so they see the bodies where
+   *  they were at the end of the last physics phase, and bodies without
+   *  collision detection are found as well. They do not change any state, so
+   *  several threads may query at once, such as when updating the AI of many
+   *  entities in parallel, as long as no thread updates physics meanwhile.
+   *
+   *  @param  point   The point in world space.
+   *  @param  mask    Only bodies on any of these layers are found.
+   *  @param  result  The entities found will be appended here. Reusing the
+   *                  same vector avoids allocating memory once it has grown.
+   *  @return The number of entities found.
+   */
+  size_t queryPoint(Vector2 point,
+                    CollisionLayer mask,
+                    vector<Entity*> & result);
+  
+  /**
+   *  Finds the entities whose collision bounds overlap an area, in the order
+   *  they are in the entity tree. See *queryPoint*.
+   *
+   *  @param  area    The area in world space.
+   *  @param  mask    Only bodies on any of these layers are found.
+   *  @param  result  The entities found will be appended here.
+   *  @return The number of entities found.
+   */
+  size_t queryAABB(AABB area, CollisionLayer mask, vector<Entity*> & result);
+  
+  /**
+   *  Casts a ray and finds the first body it hits. A ray that starts inside
+   *  of a body hits it at once. Of bodies hit at the same time, the one first
+   *  in the entity tree is reported. See *queryPoint*.
+   *
+   *  @param  origin    Where the ray starts, in world space.
+   *  @param  distance  The direction and length of the ray.
+   *  @param  mask      Only bodies on any of these layers are hit.
+   *  @param  hit       Where the ray hits, if it hits anything.
+   *  @return True if the ray hits a body.
+   */
+  bool raycast(Vector2 origin,
+               Vector2 distance,
+               CollisionLayer mask,
+               RaycastHit & hit);
   void keyStatus(KeyStatus & keys);
   double elapsedTime();
   double effectiveElapsedTime();
@@ -306,6 +783,21 @@ public:
   prop<int>  order;
   prop<bool> enabled;
   
+  /**
+   *  Whether the dimensions of the entity at its world position overlap the
+   *  view. Updated for enabled entities with graphics once per frame while
+   *  the core is not paused, notifying DidMoveIntoView and DidMoveOutOfView.
+   */
+  prop_r<Entity, bool> in_view;
+  
+  /**
+   *  Whether the bodies of the entity and its descendants are tested as a
+   *  whole before testing them one by one, which is off by default. Suits
+   *  entities of a few dozen bodies. Compounds nested within a compound are
+   *  part of the outer one.
+   */
+  prop<bool> compound;
+  
   string id();
     
   // MARK: Member functions
@@ -401,6 +893,12 @@ class InputComponent
 };
 
 
+/**
+ *  Identifies a curve registered with the CurveLibrary.
+ */
+typedef int CurveHandle;
+const CurveHandle NULL_CURVE = -1;
+
 /**
  *  AnimationComponent is responsible for moving an Entity according to a path,
  *  either in local space or in world space.
@@ -417,8 +915,28 @@ public:
   prop_r<AnimationComponent, bool> animating;
   prop_r<AnimationComponent, Vector2> end_velocity;
   
+  /**
+   *  The number of positions that curves are baked into when added, and
+   *  interpolated linearly between, or 0 to evaluate the curves every frame,
+   *  which is the default. Each sample costs 16 bytes per curve.
+   */
+  prop<int> baked_samples;
+  
   virtual void reset();
+  
+  /**
+   *  Appends a segment to the curve with the given id. The curve is
+   *  registered with the CurveLibrary the first time it is animated, so
+   *  building it segment by segment leaves no partial curves behind.
+   *  Extending a curve that has already been animated registers the longer
+   *  curve anew, since curves in the CurveLibrary never change.
+   */
   void addSegment(string id, Vector2 point, Vector2 velocity);
+  
+  /**
+   *  Names a curve of the CurveLibrary, so that it can be animated by id.
+   */
+  void addCurve(string id, CurveHandle curve);
   void removeCurve(string id);
   
   /**
@@ -431,20 +949,105 @@ public:
                         double duration,
                         bool update_velocity = false);
   
+  /**
+   *  Initiates an animation along a curve of the CurveLibrary, which takes
+   *  constant time and does not allocate.
+   */
+  void performAnimation(CurveHandle curve,
+                        double duration,
+                        bool update_velocity = false);
+  
+  /**
+   *  Does nothing, since the core advances all animations in a single pass
+   *  at the start of the animation phase, and notifies observers of the
+   *  animations that stopped once all have been advanced. Subclasses may
+   *  override it to act on the state of the animation.
+   */
   virtual void update(Core & core);
   
 private:
   string trait();
+  void _advance(Core & core, double elapsed, HermiteArray & segments);
+  void _stop(Core & core);
   
-  map<string, CubicHermiteCurve> _curves;
-  CubicHermiteCurve _current_curve;
+  map<string, CurveHandle> _curves;
+  map<string, CubicHermiteCurve> _pending_curves;
+  const CubicHermiteCurve * _current_curve;
+  const vector<Vector2> * _current_samples;
   Vector2 _start_position;
   double _start_time;
   double _duration;
   bool _update_velocity;
+  
+  friend Core;
+};
+
+
+//
+// MARK: - CurveLibrary
+//
+
+/**
+ *  Defines the library of animation curves, which are registered once and
+ *  then referred to by handle. Curves never change once registered, so any
+ *  number of animations may share them. Registering a curve identical to one
+ *  already in the library hands back the handle of the existing curve, so
+ *  that entities of the same kind share the memory of their curves.
+ */
+class CurveLibrary
+{
+  struct _Curve
+  {
+    AnimationComponent::CubicHermiteCurve segments;
+    
+    // the baked samples of the curve, by number of samples
+    map<int, vector<Vector2>> samples;
+  };
+  
+  // curves are never removed, and stay in place as curves are added
+  deque<_Curve> _curves;
+  map<vector<double>, CurveHandle> _handles;
+  
+  CurveLibrary() {};
+public:
+  CurveLibrary(CurveLibrary const &) = delete;
+  static CurveLibrary & main();
+  
+  /**
+   *  Registers a curve, unless an identical curve is already registered.
+   *
+   *  @return The handle of the curve, which stays valid for as long as the
+   *          program runs.
+   */
+  CurveHandle add(const AnimationComponent::CubicHermiteCurve & curve);
+  
+  const AnimationComponent::CubicHermiteCurve & curve(CurveHandle handle);
+  
+  /**
+   *  Finds the positions of a curve sampled at evenly spaced points along it,
+   *  which are baked the first time they are asked for.
+   *
+   *  @param  num_samples  The number of samples, which is at least 2.
+   *  @return The samples, or no samples if the curve has a single point.
+   */
+  const vector<Vector2> & samples(CurveHandle handle, int num_samples);
+  
+  void operator=(CurveLibrary const &) = delete;
 };
 
 
+/**
+ *  Defines a contact between a body and another entity, and whether the
+ *  contact started, went on or ended during the last physics phase.
+ */
+struct Contact
+{
+  enum Phase { ENTER, STAY, EXIT };
+  
+  Entity * entity;
+  Phase phase;
+};
+
 /**
  *  PhysicsComponent is responsible for updating the position of an Entity
  *  object, w.r.t. the laws of physics.
@@ -453,23 +1056,139 @@ class PhysicsComponent
   : public Component
 {
   bool _should_simulate;
-  bool _out_of_view;
   bool _did_collide;
+  bool _did_move;
+  double _idle_time;
+  bool _was_enabled;
+  unsigned _change_stamp;
+  bool _staged;
+  bool _staged_should_move;
+  int _staged_num_steps;
+  Vector2 _staged_start_position;
+  Vector2 _staged_start_velocity;
+  Vector2 _staged_velocity;
+  Vector2 _staged_motion;
+  Vector2 _staged_distance;
+  vector<void*> _staged_candidates;
+  vector<AABB> _staged_bounds;
+  vector<Vector2> _staged_motions;
+  vector<Entity*> _staged_collisions;
+  vector<Core::_DynamicContact> _staged_contacts;
+  vector<Entity*> _touching;
+  vector<Entity*> _touched;
+  vector<Entity*> _overlapping;
+  vector<void*> _overlaps;
+  Broadphase * _broadphase;
+  BroadphaseProxy _proxy;
+  CollisionFilter _proxy_filter;
+  Core::_Compound * _compound;
+  unsigned _body_stamp;
+  unsigned _body_index;
+  AABB _world_bounds;
+  AABB _swept_bounds;
   
   string trait();
+  int _numSteps(Core & core);
+  void _integrate(Core & core,
+                  double step_time,
+                  Vector2 & velocity,
+                  Vector2 & distance);
+  bool _updateContacts();
+  void _updateTrigger(Core & core);
+  void _findTriggers(Core & core, Vector2 travel_distance);
 protected:
   prop_r<PhysicsComponent, vector<Entity*>> collided_entities;
+  
+  /**
+   *  The contacts with the entities collided with during the last physics
+   *  phase, along with those that ended then. The body keeps the entities it
+   *  touches from one phase to the next, so that every contact enters once,
+   *  stays while the entities keep touching, and exits once. Observers of
+   *  DidStartColliding and DidStopColliding are notified when at least one
+   *  contact enters or exits.
+   */
+  prop_r<PhysicsComponent, vector<Contact>> contacts;
 public:
   static constexpr int pixels_per_meter = 120;
-  prop<   Rectangle> collision_bounds;
-  prop<     Vector2> gravity;
-  prop<        bool> dynamic;
-  prop<        bool> collision_detection;
-  prop<        bool> collision_response;
+  
+  /**
+   *  Bodies fall asleep once they have moved slower than *sleep_speed*, in
+   *  pixels per second, for *sleep_delay* seconds.
+   */
+  static constexpr double sleep_speed = 1;
+  static constexpr double sleep_delay = 0.5;
+  
+  prop<     Rectangle> collision_bounds;
+  prop<       Vector2> gravity;
+  prop<          bool> dynamic;
+  prop<          bool> collision_detection;
+  prop<          bool> collision_response;
+  
+  /**
+   *  How much of its velocity along a surface the body loses when it hits
+   *  the surface, from 0 for sliding freely to 1 for stopping dead.
+   */
+  prop<        double> friction;
+  
+  /**
+   *  The mass of the body, which decides how much it gives way to the other
+   *  dynamic bodies that it collides with. Bodies that are not dynamic, or
+   *  whose mass is 0, never give way.
+   */
+  prop<        double> mass;
+  
+  /**
+   *  The layer of the body, and the layers that it detects collisions with and
+   *  responds to. Obsticles that are not on any of the *collides_with* layers
+   *  are never tested against, and only obsticles on the *responds_to* layers
+   *  block the body.
+   */
+  prop<CollisionLayer> layer;
+  prop<CollisionLayer> collides_with;
+  prop<CollisionLayer> responds_to;
+  
+  /**
+   *  Whether the body is asleep, which it falls when it has been idle for a
+   *  while without any contacts starting or ending, and while not animating.
+   *  Sleeping bodies are skipped by integration and collision detection,
+   *  keeping their velocity and contacts, until they wake. They wake when hit
+   *  by a body that collides with them, when the velocity of their entity is
+   *  changed, when their entity is moved to a position or starts animating,
+   *  when reset, and when a body they touch moves, is disabled or is removed.
+   */
+  prop_r<PhysicsComponent, bool> sleeping;
+  prop<bool> can_sleep;
+  
+  /**
+   *  Whether the body is swept for collisions once across the whole frame,
+   *  rather than once per sub-step. Its motion is still integrated in
+   *  sub-steps, which keeps fast bodies from ever passing through obsticles
+   *  at the cost of a single sweep.
+   */
+  prop<bool> continuous;
+  
+  /**
+   *  The most sub-steps that the body splits a frame into, which caps its
+   *  cost during long frames. Beyond it, the sub-steps grow longer.
+   */
+  prop<int> max_substeps;
+  
+  /**
+   *  Whether the body is a trigger, which is off by default. Triggers are
+   *  never moved by physics or collided with. They report the bodies they
+   *  overlap on the layers they collide with as contacts, and are reported by
+   *  the bodies colliding with their layer. Spatial queries skip them.
+   */
+  prop<bool> trigger;
+  
+  friend Core;
   
   PhysicsComponent();
+  virtual ~PhysicsComponent();
   virtual void init(Entity * entity);
+  virtual void reset();
   virtual void update(Core & core);
+  void wake();
 };
 
 
@@ -520,12 +1239,33 @@ class GraphicsComponent
   string trait();
 protected:
   prop<  Sprite*> current_sprite;
+  
+  /**
+   *  Shows the frames of a flipbook from now on, until another flipbook is
+   *  played or *stopFlipbook* is called. The core sets the current sprite to
+   *  the frame due before the graphics are updated, so the flipbook has to
+   *  outlive its playback.
+   */
+  void playFlipbook(const Flipbook * flipbook);
+  
+  /**
+   *  Stops changing the current sprite, and leaves it at the last frame shown.
+   */
+  void stopFlipbook();
 public:
   prop_r<GraphicsComponent, Rectangle> bounds;
   
+  GraphicsComponent();
   void offsetTo(int x, int y);
   void offsetBy(int dx, int dy);
   void resizeTo(int w, int h);
   void resizeBy(int dw, int dh);
   virtual void update(Core & core);
+  
+private:
+  const Flipbook * _flipbook;
+  double _flipbook_start_time;
+  bool _is_culled;
+  
+  friend Core;
 };
@@ -0,0 +1,51 @@
+//
+//  integration.hpp
+//  Arcade Game Engine
+//
+
+#pragma once
+
+#include "types.hpp"
+
+using namespace std;
+
+
+//
+// MARK: - Integrators
+//
+
+/**
+ *  Defines how bodies advance their velocity and position over a step, given
+ *  the change in velocity that the step brings.
+ *
+ *  SEMI_IMPLICIT_EULER first changes the velocity, and then moves the body by
+ *  the new velocity. VELOCITY_VERLET moves the body by the average of the old
+ *  and new velocity, which is exact for a constant acceleration such as
+ *  gravity, so that falls land in the same place however long the steps are.
+ */
+enum Integrator
+{
+  SEMI_IMPLICIT_EULER,
+  VELOCITY_VERLET
+};
+
+/**
+ *  Advances the velocity and distance travelled of a body by one step.
+ */
+inline void integrate(Vector2 & velocity,
+                      Vector2 & distance,
+                      Vector2 velocity_change,
+                      double step_time,
+                      Integrator integrator)
+{
+  if (integrator == VELOCITY_VERLET)
+  {
+    distance += (velocity + velocity_change*0.5)*step_time;
+    velocity += velocity_change;
+  }
+  else
+  {
+    velocity += velocity_change;
+    distance += velocity*step_time;
+  }
+}
@@ -4,6 +4,8 @@
 //
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
 #include "core.hpp"
 
 
@@ -11,287 +13,1072 @@
 // MARK: - Core
 //
 
-void _resolveCollisions(Entity & collider,
-                        Entity & obsticle,
-                        Vector2 & travel_distance,
-                        bool collision_response,
+/**
+ *  Removes the part of a motion that goes into a surface, and scales what is
+ *  left by the friction against it.
+ */
+Vector2 _slide(Vector2 motion, Vector2 normal, double friction)
+{
+  const double into = motion.x*normal.x + motion.y*normal.y;
+  if (into >= 0) return motion;
+  return (motion - normal*into) * (1 - friction);
+}
+
+FixedVector2 _slide(FixedVector2 motion, FixedVector2 normal, Fixed friction)
+{
+  const Fixed into = motion.x*normal.x + motion.y*normal.y;
+  if (into >= Fixed {0}) return motion;
+  return (motion - normal*into) * (Fixed {FIXED_ONE} - friction);
+}
+
+/**
+ *  @return How much a body gives way when colliding, where 0 means not at all.
+ */
+double _inverseMass(PhysicsComponent * body)
+{
+  return body->dynamic() && body->mass() > 0 ? 1 / body->mass() : 0;
+}
+
+/**
+ *  @return How deep two boxes overlap along the axis of a normal, or 0 if they
+ *          do not overlap.
+ */
+double _penetration(AABB a, AABB b, Vector2 normal)
+{
+  if (a.min.x >= b.max.x || b.min.x >= a.max.x ||
+      a.min.y >= b.max.y || b.min.y >= a.max.y)
+  {
+    return 0;
+  }
+  return normal.x != 0 ? min(a.max.x - b.min.x, b.max.x - a.min.x)
+                       : min(a.max.y - b.min.y, b.max.y - a.min.y);
+}
+
+Fixed _penetration(FixedAABB a, FixedAABB b, FixedVector2 normal)
+{
+  if (a.min.x >= b.max.x || b.min.x >= a.max.x ||
+      a.min.y >= b.max.y || b.min.y >= a.max.y)
+  {
+    return {0};
+  }
+  return normal.x != Fixed {0} ? min(a.max.x - b.min.x, b.max.x - a.min.x)
+                               : min(a.max.y - b.min.y, b.max.y - a.min.y);
+}
+
+void Core::resolveCollisions(Entity & collider,
+                             Vector2 & travel_distance,
+                             bool collision_response,
+                             vector<Entity *> & result)
+{
+  PhysicsComponent * physics = collider.physics();
+  if (!physics) return;
+  
+  Vector2 position;
+  collider.calculateWorldPosition(position);
+  const AABB bounds = make_aabb(position, physics->collision_bounds());
+  _queryCandidates(physics, bounds, travel_distance, _candidates);
+  
+  // dynamic obsticles that are yet to move are swept against by the motion
+  // relative to them
+  _obsticle_bounds.clear();
+  _obsticle_motions.clear();
+  for (auto candidate : _candidates)
+  {
+    PhysicsComponent * obsticle = (PhysicsComponent*)candidate;
+    Vector2 obsticle_position;
+    obsticle->entity()->calculateWorldPosition(obsticle_position);
+    _obsticle_bounds.push_back(make_aabb(obsticle_position,
+                                         obsticle->collision_bounds()));
+    _obsticle_motions.push_back(!obsticle->_did_move &&
+                                _inverseMass(obsticle) > 0
+                                  ? obsticle->entity()->velocity()*delta_time()
+                                  : Vector2 {0, 0});
+  }
+  
+  Vector2 velocity = collider.velocity();
+  _sweep(physics,
+         bounds,
+         travel_distance,
+         velocity,
+         collision_response,
+         _candidates,
+         _obsticle_bounds,
+         _obsticle_motions,
+         result,
+         _dynamic_contacts);
+  collider.changeVelocityTo(velocity.x, velocity.y);
+  
+  for (auto entity : result) entity->physics()->wake();
+}
+
+size_t Core::queryPoint(Vector2 point,
+                        CollisionLayer mask,
                         vector<Entity*> & result)
 {
-  if (collider.physics() && obsticle.physics() && &collider != &obsticle)
+  return queryAABB({point, point}, mask, result);
+}
+
+size_t Core::queryAABB(AABB area, CollisionLayer mask, vector<Entity*> & result)
+{
+  // each thread keeps its own bodies, so that queries may run concurrently
+  static thread_local vector<void*> bodies;
+  _queryBodies(area, mask, bodies);
+  for (auto body : bodies)
+  {
+    result.push_back(((PhysicsComponent*)body)->entity());
+  }
+  return bodies.size();
+}
+
+bool Core::raycast(Vector2 origin,
+                   Vector2 distance,
+                   CollisionLayer mask,
+                   RaycastHit & hit)
+{
+  static thread_local vector<void*> bodies;
+  const AABB ray {origin, origin};
+  bodies.clear();
+  broadphase()->querySwept(ray, distance, mask, bodies);
+  for (auto & entry : _layer_broadphases)
+  {
+    if (entry.first & mask)
+    {
+      entry.second->querySwept(ray, distance, mask, bodies);
+    }
+  }
+  for (auto compound : _compounds)
+  {
+    if ((compound->layers & mask) &&
+        sweep_overlaps(ray, distance, compound->bounds))
+    {
+      compound->bodies.querySwept(ray, distance, mask, bodies);
+    }
+  }
+  
+  PhysicsComponent * closest = nullptr;
+  SweepHit closest_hit;
+  for (auto body : bodies)
+  {
+    PhysicsComponent * physics = (PhysicsComponent*)body;
+    SweepHit body_hit;
+    if (!sweep_aabb(ray, distance, physics->_world_bounds, body_hit)) continue;
+    
+    if (!closest ||
+        body_hit.time < closest_hit.time ||
+        (body_hit.time == closest_hit.time &&
+         physics->_body_index < closest->_body_index))
+    {
+      closest = physics;
+      closest_hit = body_hit;
+    }
+  }
+  if (!closest) return false;
+  
+  hit.entity = closest->entity();
+  hit.position = origin + distance*closest_hit.time;
+  hit.normal = closest_hit.normal;
+  hit.time = closest_hit.time;
+  return true;
+}
+
+void Core::useBroadphase(Broadphase * broadphase)
+{
+  _clearProxies();
+  delete this->broadphase();
+  this->broadphase(broadphase);
+}
+
+void Core::useBroadphase(Broadphase * broadphase, CollisionLayer layers)
+{
+  _clearProxies();
+  for (auto & entry : _layer_broadphases)
   {
-    Rectangle collider_cb = collider.physics()->collision_bounds();
-    Rectangle obsticle_cb = obsticle.physics()->collision_bounds();
-    Vector2 col_pos, obs_pos;
-    collider.calculateWorldPosition(col_pos);
-    obsticle.calculateWorldPosition(obs_pos);
+    if (entry.first == layers)
+    {
+      delete entry.second;
+      entry.second = broadphase;
+      return;
+    }
+  }
+  _layer_broadphases.push_back({layers, broadphase});
+}
+
+// MARK: Private member functions
+
+Broadphase * Core::_broadphaseFor(PhysicsComponent * body)
+{
+  if (body->trigger()) return _trigger_broadphase;
+  if (body->_compound) return &body->_compound->bodies;
+  
+  for (auto & entry : _layer_broadphases)
+  {
+    if (entry.first & body->layer()) return entry.second;
+  }
+  return broadphase();
+}
+
+void Core::_updateBroadphase()
+{
+  _body_stamp += 1;
+  static vector<pair<PhysicsComponent*, Vector2>> bodies;
+  bodies.clear();
+  _collectBodies(*root(), {0, 0}, nullptr, bodies);
+  
+  _previous_bodies.swap(_bodies);
+  _bodies.clear();
+  _num_triggers = 0;
+  
+  for (auto pair : bodies)
+  {
+    PhysicsComponent * body = pair.first;
+    body->_staged = false;
+    const AABB bounds = make_aabb(pair.second, body->collision_bounds());
+    const AABB & previous_bounds = body->_world_bounds;
+    const bool is_enabled = body->entity()->enabled();
+    
+    // bodies that moved since the last phase, or were disabled, may have
+    // been holding up the bodies sleeping on them
+    if (body->_did_move || (body->_was_enabled && !is_enabled) ||
+        bounds.min.x != previous_bounds.min.x ||
+        bounds.min.y != previous_bounds.min.y ||
+        bounds.max.x != previous_bounds.max.x ||
+        bounds.max.y != previous_bounds.max.y)
+    {
+      body->_change_stamp = _body_stamp;
+    }
+    body->_was_enabled = is_enabled;
     
-    SDL_Rect collider_before_rect
+    body->_body_stamp = _body_stamp;
+    body->_body_index = (unsigned)_bodies.size();
+    body->_did_move = false;
+    body->_world_bounds = bounds;
+    if (body->_compound && !body->trigger())
     {
-      (int)(col_pos.x + collider_cb.pos.x),
-      (int)(col_pos.y + collider_cb.pos.y),
-      (int)collider_cb.dim.x,
-      (int)collider_cb.dim.y
-    };
+      _Compound * compound = body->_compound;
+      compound->bounds = merge(compound->bounds, body->_world_bounds);
+      compound->layers |= body->layer();
+    }
     
-    SDL_Rect obsticle_rect
+    // bodies whose layers have changed, or that have become or stopped being
+    // triggers, are inserted anew, possibly into another broadphase
+    const CollisionFilter filter {body->layer(), body->collides_with()};
+    Broadphase * broadphase = _broadphaseFor(body);
+    if (body->trigger()) _num_triggers += 1;
+    if (body->_proxy != NULL_PROXY &&
+        (broadphase != body->_broadphase ||
+         filter.layer != body->_proxy_filter.layer ||
+         filter.mask  != body->_proxy_filter.mask))
     {
-      (int)(obs_pos.x + obsticle_cb.pos.x),
-      (int)(obs_pos.y + obsticle_cb.pos.y),
-      (int)obsticle_cb.dim.x,
-      (int)obsticle_cb.dim.y
-    };
+      body->_broadphase->remove(body->_proxy);
+      body->_proxy = NULL_PROXY;
+    }
     
-    // second condition is a hack for enemies not colliding away from each other
-    bool is_responding = collision_response && !obsticle.physics()->dynamic();
+    if (body->_proxy == NULL_PROXY)
+    {
+      body->_proxy = broadphase->insert(body->_world_bounds, body, filter);
+      body->_proxy_filter = filter;
+      body->_broadphase = broadphase;
+    }
+    else
+    {
+      body->_broadphase->update(body->_proxy, body->_world_bounds);
+    }
+    _bodies.push_back(body);
+  }
+  
+  // remove the bodies that are no longer in the tree
+  for (auto body : _previous_bodies)
+  {
+    if (body->_body_stamp != _body_stamp && body->_proxy != NULL_PROXY)
+    {
+      body->_broadphase->remove(body->_proxy);
+      body->_proxy = NULL_PROXY;
+      body->_change_stamp = _body_stamp;
+    }
+  }
+  
+  // wake the sleeping bodies that a changed body may have been holding up,
+  // where the bodies they touch are alive, since removing a body wakes the
+  // bodies touching it
+  for (auto body : _bodies)
+  {
+    if (!body->sleeping() || !body->dynamic()) continue;
     
-    // check so that the collider is not already colliding with obsticle
-    SDL_Rect intersection_rect;
-    if (!SDL_IntersectRect(&collider_before_rect,
-                           &obsticle_rect,
-                           &intersection_rect))
-    {
-      // collider is outside of obsticle
-      SDL_Rect collider_after_rect
+    for (auto entity : body->_touching)
+    {
+      if (entity->physics() &&
+          entity->physics()->_change_stamp == _body_stamp)
       {
-        (int)(col_pos.x + collider_cb.pos.x + travel_distance.x),
-        (int)(col_pos.y + collider_cb.pos.y + travel_distance.y),
-        (int)collider_cb.dim.x,
-        (int)collider_cb.dim.y
-      };
+        body->wake();
+        break;
+      }
+    }
+  }
+  
+  // forget the compounds that are no longer in the tree, now that their
+  // bodies have been removed from them
+  for (auto & compound : _compounds)
+  {
+    if (compound->stamp != _body_stamp)
+    {
+      delete compound;
+      compound = nullptr;
+    }
+  }
+  _compounds.erase(std::remove(_compounds.begin(), _compounds.end(), nullptr),
+                   _compounds.end());
+}
+
+void Core::_collectBodies(Entity & entity,
+                          Vector2 parent_position,
+                          _Compound * compound,
+                          vector<pair<PhysicsComponent*, Vector2>> & result)
+{
+  const Vector2 world_position = parent_position + entity.local_position();
+  if (entity.compound() && !compound) compound = _compoundFor(entity);
+  if (entity.physics())
+  {
+    entity.physics()->_compound = compound;
+    result.push_back({entity.physics(), world_position});
+  }
+  
+  for (auto child : entity.children())
+  {
+    _collectBodies(*child, world_position, compound, result);
+  }
+}
+
+Core::_Compound * Core::_compoundFor(Entity & entity)
+{
+  _Compound * compound = nullptr;
+  for (auto existing : _compounds)
+  {
+    if (existing->entity == &entity) compound = existing;
+  }
+  if (!compound)
+  {
+    compound = new _Compound();
+    compound->entity = &entity;
+    _compounds.push_back(compound);
+  }
+  
+  // the bounds are found anew every physics phase
+  compound->bounds = EMPTY_AABB;
+  compound->layers = NO_LAYERS;
+  compound->stamp = _body_stamp;
+  return compound;
+}
+
+void Core::_removeBody(PhysicsComponent * body)
+{
+  if (body->_proxy != NULL_PROXY)
+  {
+    body->_broadphase->remove(body->_proxy);
+    body->_proxy = NULL_PROXY;
+  }
+  
+  // the bodies touching it wake, and forget it once they are updated
+  for (auto other : _bodies)
+  {
+    if (find(other->_touching.begin(),
+             other->_touching.end(),
+             body->entity()) != other->_touching.end())
+    {
+      other->wake();
+    }
+  }
+  _bodies.erase(std::remove(_bodies.begin(), _bodies.end(), body),
+                _bodies.end());
+  _previous_bodies.erase(std::remove(_previous_bodies.begin(),
+                                     _previous_bodies.end(),
+                                     body),
+                         _previous_bodies.end());
+  auto has_body = [body](const _DynamicContact & contact)
+  {
+    return contact.a == body || contact.b == body;
+  };
+  _dynamic_contacts.erase(remove_if(_dynamic_contacts.begin(),
+                                    _dynamic_contacts.end(),
+                                    has_body),
+                          _dynamic_contacts.end());
+}
+
+void Core::_clearProxies()
+{
+  for (auto body : _bodies)
+  {
+    if (body->_proxy != NULL_PROXY) body->_broadphase->remove(body->_proxy);
+    body->_proxy = NULL_PROXY;
+  }
+  for (auto body : _previous_bodies)
+  {
+    if (body->_proxy != NULL_PROXY) body->_broadphase->remove(body->_proxy);
+    body->_proxy = NULL_PROXY;
+  }
+  _bodies.clear();
+  _previous_bodies.clear();
+}
+
+void Core::_queryBodies(AABB area, CollisionLayer mask, vector<void*> & result)
+{
+  result.clear();
+  broadphase()->query(area, mask, result);
+  for (auto & entry : _layer_broadphases)
+  {
+    if (entry.first & mask) entry.second->query(area, mask, result);
+  }
+  for (auto compound : _compounds)
+  {
+    if ((compound->layers & mask) && overlaps(area, compound->bounds))
+    {
+      compound->bodies.query(area, mask, result);
+    }
+  }
+  
+  // report the bodies in tree order, so that collisions are resolved in the
+  // same order every frame
+  sort(result.begin(), result.end(), [](void * l, void * r)
+  {
+    return ((PhysicsComponent*)l)->_body_index <
+           ((PhysicsComponent*)r)->_body_index;
+  });
+}
+
+void Core::_queryCandidates(PhysicsComponent * physics,
+                            AABB bounds,
+                            Vector2 travel_distance,
+                            vector<void*> & result)
+{
+  // sliding keeps the collider within the box enclosing the whole sweep
+  _queryBodies(sweep(bounds, travel_distance),
+               physics->collides_with(),
+               result);
+  _num_pairs += count_if(result.begin(),
+                         result.end(),
+                         [physics](void * body) { return body != physics; });
+}
+
+void Core::_sweep(PhysicsComponent * physics,
+                  AABB bounds,
+                  Vector2 & travel_distance,
+                  Vector2 & velocity,
+                  bool collision_response,
+                  const vector<void*> & candidates,
+                  const vector<AABB> & obsticle_bounds,
+                  const vector<Vector2> & obsticle_motions,
+                  vector<Entity*> & result,
+                  vector<_DynamicContact> & contacts)
+{
+  if (fixed_point())
+  {
+    _sweepFixed(physics,
+                bounds,
+                travel_distance,
+                velocity,
+                collision_response,
+                candidates,
+                obsticle_bounds,
+                obsticle_motions,
+                result,
+                contacts);
+    return;
+  }
+  
+  //// move until the first blocking obsticle is hit, then slide along it with
+  //// the distance left, a few times over
+  const int max_iterations = 4;
+  Vector2 moved {0, 0};
+  Vector2 remaining = travel_distance;
+  double time_left = 1;
+  for (int iteration = 0; iteration < max_iterations; iteration++)
+  {
+    const AABB current {bounds.min + moved, bounds.max + moved};
+    SweepHit first_hit {numeric_limits<double>::infinity(), {0, 0}, 0};
+    PhysicsComponent * first_obsticle = nullptr;
+    
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+      PhysicsComponent * obsticle = (PhysicsComponent*)candidates[i];
+      if (obsticle == physics) continue;
+      
+      // sweep from where the obsticle is by now, by the motion relative to it
+      const Vector2 offset = obsticle_motions[i] * (1 - time_left);
+      const AABB current_obsticle {obsticle_bounds[i].min + offset,
+                                   obsticle_bounds[i].max + offset};
+      const Vector2 relative = remaining - obsticle_motions[i] * time_left;
       
-      // the bounding box for the colliders before and after traviling the
-      // distance
-      SDL_Rect large_rect;
-      large_rect.x = (int)min(min_x(collider_before_rect),
-                              min_x(collider_after_rect));
-      large_rect.y = (int)min(min_y(collider_before_rect),
-                              min_y(collider_after_rect));
-      large_rect.w = (int)max(max_x(collider_before_rect),
-                              max_x(collider_after_rect)) - large_rect.x;
-      large_rect.h = (int)max(max_y(collider_before_rect),
-                              max_y(collider_after_rect)) - large_rect.y;
+      SweepHit hit;
+      if (!sweep_aabb(current, relative, current_obsticle, hit)) continue;
       
-      if (SDL_IntersectRect(&large_rect, &obsticle_rect, &intersection_rect))
+      if (find(result.begin(), result.end(), obsticle->entity()) ==
+          result.end())
       {
-        // collider will collide with obsticle between this frame and the next
-        result.push_back(&obsticle);
-        
-        if (is_responding)
-        {
-          typedef struct { int x1, y1, x2, y2; } Line;
-          
-          auto distance = [](int x1, int y1, int x2, int y2)
-          {
-            double dx = x2-x1;
-            double dy = y2-y1;
-            return sqrt(dx*dx+dy*dy);
-          };
-          
-          Line upper_left, upper_right, lower_left, lower_right;
-          
-          upper_left.x1  = (int)min_x(collider_before_rect);
-          upper_left.y1  = (int)min_y(collider_before_rect);
-          upper_left.x2  = (int)min_x(collider_after_rect);
-          upper_left.y2  = (int)min_y(collider_after_rect);
-          
-          upper_right.x1 = (int)max_x(collider_before_rect);
-          upper_right.y1 = (int)min_y(collider_before_rect);
-          upper_right.x2 = (int)max_x(collider_after_rect);
-          upper_right.y2 = (int)min_y(collider_after_rect);
-          
-          lower_left.x1  = (int)min_x(collider_before_rect);
-          lower_left.y1  = (int)max_y(collider_before_rect);
-          lower_left.x2  = (int)min_x(collider_after_rect);
-          lower_left.y2  = (int)max_y(collider_after_rect);
-          
-          lower_right.x1 = (int)max_x(collider_before_rect);
-          lower_right.y1 = (int)max_y(collider_before_rect);
-          lower_right.x2 = (int)max_x(collider_after_rect);
-          lower_right.y2 = (int)max_y(collider_after_rect);
-          
-          int intersections = 0;
-          intersections += SDL_IntersectRectAndLine(&obsticle_rect,
-                                                        &upper_left.x1,
-                                                        &upper_left.y1,
-                                                        &upper_left.x2,
-                                                        &upper_left.y2);
-          intersections += SDL_IntersectRectAndLine(&obsticle_rect,
-                                                        &upper_right.x1,
-                                                        &upper_right.y1,
-                                                        &upper_right.x2,
-                                                        &upper_right.y2);
-          intersections += SDL_IntersectRectAndLine(&obsticle_rect,
-                                                        &lower_left.x1,
-                                                        &lower_left.y1,
-                                                        &lower_left.x2,
-                                                        &lower_left.y2);
-          intersections += SDL_IntersectRectAndLine(&obsticle_rect,
-                                                        &lower_right.x1,
-                                                        &lower_right.y1,
-                                                        &lower_right.x2,
-                                                        &lower_right.y2);
-          
-          if (intersections > 0)
-          {
-            //// find the line with the shortest distance to its originating
-            //// corner
-            int current_distance;
-            
-            // upper left corner
-            int index = 0;
-            int shortest_distance = (int)distance((int)min_x(collider_before_rect),
-                                                   (int)min_y(collider_before_rect),
-                                                   upper_left.x1,
-                                                   upper_left.y1);
-            
-            // upper right corner
-            current_distance = (int)distance((int)max_x(collider_before_rect),
-                                             (int)min_y(collider_before_rect),
-                                             upper_right.x1,
-                                             upper_right.y1);
-            if (current_distance < shortest_distance)
-            {
-              index = 1;
-              shortest_distance = current_distance;
-            }
-            
-            // lower left corner
-            current_distance = (int)distance((int)min_x(collider_before_rect),
-                                             (int)max_y(collider_before_rect),
-                                             lower_left.x1,
-                                             lower_left.y1);
-            if (current_distance < shortest_distance)
-            {
-              index = 2;
-              shortest_distance = current_distance;
-            }
-            
-            // lower right corner
-            current_distance = (int)distance((int)max_x(collider_before_rect),
-                                             (int)max_y(collider_before_rect),
-                                             lower_right.x1,
-                                             lower_right.y1);
-            if (current_distance < shortest_distance)
-            {
-              index = 3;
-              shortest_distance = current_distance;
-            }
-            
-            // update travel distance
-            switch (index)
-            {
-              case 0:
-                travel_distance.x = min_x(collider_before_rect)-upper_left.x1;
-                travel_distance.y = min_y(collider_before_rect)-upper_left.y1;
-                break;
-              case 1:
-                travel_distance.x = max_x(collider_before_rect)-upper_right.x1;
-                travel_distance.y = min_y(collider_before_rect)-upper_right.y1;
-                break;
-              case 2:
-                travel_distance.x = min_x(collider_before_rect)-lower_left.x1;
-                travel_distance.y = max_y(collider_before_rect)-lower_left.y1;
-                break;
-              case 3:
-                travel_distance.x = max_x(collider_before_rect)-lower_right.x1;
-                travel_distance.y = max_y(collider_before_rect)-lower_right.y1;
-                break;
-            }
-            
-            // update velocity
-            collider.changeVelocityTo(0, 0);
-          }
-        }
+        result.push_back(obsticle->entity());
       }
+      
+      if (collision_response &&
+          (obsticle->layer() & physics->responds_to()) &&
+          hit.time < first_hit.time)
+      {
+        first_hit = hit;
+        first_obsticle = obsticle;
+      }
+    }
+    
+    if (first_hit.time > 1)
+    {
+      moved += remaining;
+      break;
+    }
+    
+    moved += remaining*first_hit.time;
+    time_left *= 1 - first_hit.time;
+    remaining = _slide(remaining * (1 - first_hit.time),
+                       first_hit.normal,
+                       physics->friction());
+    
+    if (_inverseMass(first_obsticle) > 0)
+    {
+      // leave separating the bodies and evening out their velocities to the
+      // contact solver, once all bodies have moved
+      contacts.push_back({physics, first_obsticle, first_hit.normal});
     }
     else
     {
-      // collider is inside obsticle (rare)
-      result.push_back(&obsticle);
+      moved += first_hit.normal*first_hit.depth;
+      velocity = _slide(velocity, first_hit.normal, physics->friction());
+    }
+    
+    if (remaining.x == 0 && remaining.y == 0) break;
+  }
+  travel_distance = moved;
+}
+
+void Core::_sweepFixed(PhysicsComponent * physics,
+                       AABB bounds,
+                       Vector2 & travel_distance,
+                       Vector2 & velocity,
+                       bool collision_response,
+                       const vector<void*> & candidates,
+                       const vector<AABB> & obsticle_bounds,
+                       const vector<Vector2> & obsticle_motions,
+                       vector<Entity*> & result,
+                       vector<_DynamicContact> & contacts) const
+{
+  // the boxes are placed relative to where the body starts, which keeps the
+  // obsticles it may reach within the fixed-point range
+  static thread_local vector<FixedAABB> fixed_bounds;
+  static thread_local vector<FixedVector2> fixed_motions;
+  fixed_bounds.clear();
+  fixed_motions.clear();
+  for (size_t i = 0; i < candidates.size(); i++)
+  {
+    fixed_bounds.push_back(to_fixed(obsticle_bounds[i], bounds.min));
+    fixed_motions.push_back(to_fixed(obsticle_motions[i]));
+  }
+  const FixedAABB start = to_fixed(bounds, bounds.min);
+  const Fixed friction = to_fixed(physics->friction());
+  const Fixed zero {0};
+  const Fixed one {FIXED_ONE};
+  
+  //// move until the first blocking obsticle is hit, then slide along it with
+  //// the distance left, a few times over
+  const int max_iterations = 4;
+  FixedVector2 moved {zero, zero};
+  FixedVector2 remaining = to_fixed(travel_distance);
+  FixedVector2 fixed_velocity = to_fixed(velocity);
+  Fixed time_left = one;
+  for (int iteration = 0; iteration < max_iterations; iteration++)
+  {
+    const FixedAABB current {start.min + moved, start.max + moved};
+    FixedSweepHit first_hit {{INT32_MAX}, {zero, zero}, zero};
+    PhysicsComponent * first_obsticle = nullptr;
+    
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+      PhysicsComponent * obsticle = (PhysicsComponent*)candidates[i];
+      if (obsticle == physics) continue;
+      
+      // sweep from where the obsticle is by now, by the motion relative to it
+      const FixedVector2 offset = fixed_motions[i] * (one - time_left);
+      const FixedAABB current_obsticle {fixed_bounds[i].min + offset,
+                                        fixed_bounds[i].max + offset};
+      const FixedVector2 relative = remaining - fixed_motions[i] * time_left;
+      
+      FixedSweepHit hit;
+      if (!sweep_aabb(current, relative, current_obsticle, hit)) continue;
       
-      if (is_responding)
+      if (find(result.begin(), result.end(), obsticle->entity()) ==
+          result.end())
       {
-        //// find shortest distance to one of the obsticles edges
-        int current_distance;
-        
-        // distance to upper edge
-        int index = 0;
-        int shortest_distance = 
-          (int)min_y(obsticle_rect) - (int)min_y(collider_before_rect);
-        
-        // distance to lower edge
-        current_distance = (int)max_y(obsticle_rect) - (int)max_y(collider_before_rect);
-        if (current_distance < shortest_distance)
-        {
-          index = 1;
-          shortest_distance = current_distance;
-        }
-        
-        // distance to left edge
-        current_distance = (int)min_x(obsticle_rect) - (int)min_x(collider_before_rect);
-        if (current_distance < shortest_distance)
-        {
-          index = 2;
-          shortest_distance = current_distance;
-        }
-        
-        // distance to right edge
-        current_distance = (int)max_x(obsticle_rect) - (int)max_x(collider_before_rect);
-        if (current_distance < shortest_distance)
-        {
-          index = 3;
-          shortest_distance = current_distance;
-        }
+        result.push_back(obsticle->entity());
+      }
+      
+      if (collision_response &&
+          (obsticle->layer() & physics->responds_to()) &&
+          hit.time < first_hit.time)
+      {
+        first_hit = hit;
+        first_obsticle = obsticle;
+      }
+    }
+    
+    if (first_hit.time > one)
+    {
+      moved += remaining;
+      break;
+    }
+    
+    moved += remaining*first_hit.time;
+    time_left = time_left * (one - first_hit.time);
+    remaining = _slide(remaining * (one - first_hit.time),
+                       first_hit.normal,
+                       friction);
+    
+    if (_inverseMass(first_obsticle) > 0)
+    {
+      contacts.push_back({physics,
+                          first_obsticle,
+                          to_vector2(first_hit.normal)});
+    }
+    else
+    {
+      moved += first_hit.normal*first_hit.depth;
+      fixed_velocity = _slide(fixed_velocity, first_hit.normal, friction);
+    }
+    
+    if (remaining.x == zero && remaining.y == zero) break;
+  }
+  travel_distance = to_vector2(moved);
+  velocity = to_vector2(fixed_velocity);
+}
+
+void Core::_stagePhysics()
+{
+  //// find how far each body that is awake would move if unobstructed
+  _staged_bodies.clear();
+  for (auto body : _bodies)
+  {
+    if (!body->sleeping() && !body->trigger() && body->entity()->enabled())
+    {
+      _staged_bodies.push_back(body);
+    }
+  }
+  
+  const double delta_time = this->delta_time();
+  _parallelFor(_staged_bodies.size(), [this, delta_time](size_t i)
+  {
+    PhysicsComponent * body = _staged_bodies[i];
+    body->_staged = true;
+    body->_staged_should_move = body->_should_simulate && body->dynamic();
+    body->_staged_num_steps = body->_staged_should_move
+      ? body->_numSteps(*this)
+      : 1;
+    body->_staged_start_velocity = body->entity()->velocity();
+    body->entity()->calculateWorldPosition(body->_staged_start_position);
+    
+    Vector2 velocity = body->_staged_start_velocity;
+    body->_staged_motion = {0, 0};
+    if (body->_staged_should_move)
+    {
+      const double step_time = delta_time / body->_staged_num_steps;
+      for (int step = 0; step < body->_staged_num_steps; step++)
+      {
+        body->_integrate(*this, step_time, velocity, body->_staged_motion);
+      }
+    }
+  });
+  
+  //// find the obsticles that each body might hit, in tree order so that the
+  //// candidate pairs are counted along the way
+  for (auto body : _staged_bodies)
+  {
+    body->_staged_candidates.clear();
+    if (body->collision_detection())
+    {
+      _queryCandidates(body,
+                       body->_world_bounds,
+                       body->_staged_motion,
+                       body->_staged_candidates);
+    }
+  }
+  
+  //// move each body step by step, sweeping it against the obsticles moving
+  //// from where they were at the start of the phase by how far they would
+  //// move if unobstructed, where each body only writes to its own results
+  _parallelFor(_staged_bodies.size(), [this, delta_time](size_t i)
+  {
+    PhysicsComponent * body = _staged_bodies[i];
+    body->_staged_collisions.clear();
+    body->_staged_contacts.clear();
+    body->_staged_velocity = body->_staged_start_velocity;
+    body->_staged_distance = {0, 0};
+    
+    // continuous bodies are swept once across all steps
+    const int num_steps = body->_staged_num_steps;
+    const double share = body->continuous() ? 1 : 1.0 / num_steps;
+    body->_staged_bounds.clear();
+    body->_staged_motions.clear();
+    for (auto candidate : body->_staged_candidates)
+    {
+      PhysicsComponent * obsticle = (PhysicsComponent*)candidate;
+      body->_staged_bounds.push_back(obsticle->_world_bounds);
+      body->_staged_motions.push_back(obsticle->_staged &&
+                                      _inverseMass(obsticle) > 0
+                                        ? obsticle->_staged_motion * share
+                                        : Vector2 {0, 0});
+    }
+    
+    const double step_time = delta_time / num_steps;
+    Vector2 distance {0, 0};
+    for (int step = 0; step < num_steps; step++)
+    {
+      if (body->_staged_should_move)
+      {
+        body->_integrate(*this, step_time, body->_staged_velocity, distance);
+      }
+      
+      const bool is_last_step = step == num_steps - 1;
+      if (body->continuous() && !is_last_step) continue;
+      
+      if (body->collision_detection())
+      {
+        const AABB bounds {body->_world_bounds.min + body->_staged_distance,
+                           body->_world_bounds.max + body->_staged_distance};
+        _sweep(body,
+               bounds,
+               distance,
+               body->_staged_velocity,
+               body->_staged_should_move && body->collision_response(),
+               body->_staged_candidates,
+               body->_staged_bounds,
+               body->_staged_motions,
+               body->_staged_collisions,
+               body->_staged_contacts);
         
-        // update travel distance
-        switch (index)
+        // the obsticles move on to where they are at the start of the next
+        // step
+        for (size_t k = 0; k < body->_staged_bounds.size(); k++)
         {
-          case 0:
-            travel_distance.x = 0;
-            travel_distance.y = -(shortest_distance + collider_before_rect.h);
-            break;
-          case 1:
-            travel_distance.x = 0;
-            travel_distance.y = shortest_distance + collider_before_rect.h;
-            break;
-          case 2:
-            travel_distance.x = -(shortest_distance + collider_before_rect.w);
-            travel_distance.y = 0;
-            break;
-          case 3:
-            travel_distance.x = shortest_distance + collider_before_rect.w;
-            travel_distance.y = 0;
-            break;
+          body->_staged_bounds[k].min += body->_staged_motions[k];
+          body->_staged_bounds[k].max += body->_staged_motions[k];
         }
-        
-        // update velocity
-        collider.changeVelocityTo(0, 0);
       }
+      body->_staged_distance += distance;
+      distance = {0, 0};
+    }
+  });
+}
+
+void Core::_drawPhysicsDebug()
+{
+  RGBAColor prev_color;
+  SDL_GetRenderDrawColor(renderer(),
+                         &prev_color.r,
+                         &prev_color.g,
+                         &prev_color.b,
+                         &prev_color.a);
+  
+  // each kind of box is drawn in a single batch, in its own color
+  auto draw = [this](RGBAColor color)
+  {
+    _debug_rects.clear();
+    for (auto & box : _debug_boxes)
+    {
+      if (box.min.x > box.max.x || box.min.y > box.max.y) continue;
+      
+      // boxes that merely touch are at least a pixel wide
+      SDL_Rect rect;
+      rect.x = box.min.x * scale();
+      rect.y = box.min.y * scale();
+      rect.w = max(1, (int)((box.max.x - box.min.x) * scale()));
+      rect.h = max(1, (int)((box.max.y - box.min.y) * scale()));
+      _debug_rects.push_back(rect);
     }
+    _debug_boxes.clear();
+    
+    SDL_SetRenderDrawColor(renderer(), color.r, color.g, color.b, color.a);
+    SDL_RenderDrawRects(renderer(),
+                        _debug_rects.data(),
+                        (int)_debug_rects.size());
+  };
+  
+  //// the cells of the broadphases, and the bounds of compounds
+  broadphase()->cells(_debug_boxes);
+  for (auto & layer : _layer_broadphases) layer.second->cells(_debug_boxes);
+  _trigger_broadphase->cells(_debug_boxes);
+  for (auto compound : _compounds) _debug_boxes.push_back(compound->bounds);
+  draw({0x60, 0x60, 0x60, 0xFF});
+  
+  //// the bounds of bodies
+  for (auto body : _bodies) _debug_boxes.push_back(body->_world_bounds);
+  draw({0xFF, 0xFF, 0xFF, 0xFF});
+  
+  //// the boxes swept by the bodies that moved during the last physics phase
+  for (auto body : _bodies)
+  {
+    if (body->_did_move) _debug_boxes.push_back(body->_swept_bounds);
   }
+  draw({0xFF, 0xFF, 0x00, 0xFF});
   
-  for (auto child : obsticle.children())
+  //// where bodies touch other bodies
+  for (auto body : _bodies)
   {
-    _resolveCollisions(collider,
-                       *child,
-                       travel_distance,
-                       collision_response,
-                       result);
+    for (auto entity : body->_touching)
+    {
+      if (!entity->physics()) continue;
+      
+      const AABB a = body->_world_bounds;
+      const AABB b = entity->physics()->_world_bounds;
+      _debug_boxes.push_back({{max(a.min.x, b.min.x), max(a.min.y, b.min.y)},
+                              {min(a.max.x, b.max.x), min(a.max.y, b.max.y)}});
+    }
   }
+  draw({0xFF, 0x00, 0x00, 0xFF});
+  
+  SDL_SetRenderDrawColor(renderer(),
+                         prev_color.r,
+                         prev_color.g,
+                         prev_color.b,
+                         prev_color.a);
+  
+  //// show the stats in the window title
+  const PhysicsStats stats = physics_stats();
+  char title[256];
+  snprintf(title,
+           sizeof(title),
+           "%s - bodies %zu, pairs %zu, contacts %zu, physics %.2f ms",
+           _title.c_str(),
+           stats.bodies,
+           stats.pairs,
+           stats.contacts,
+           stats.duration * 1000);
+  SDL_SetWindowTitle(window(), title);
+  _shows_stats = true;
 }
 
-void Core::resolveCollisions(Entity & collider,
-                             Vector2 & travel_distance,
-                             bool collision_response,
-                             vector<Entity *> & result)
+void Core::_parallelFor(size_t count, function<void(size_t)> block)
 {
-  _resolveCollisions(collider,
-                     *root(),
-                     travel_distance,
-                     collision_response,
-                     result);
+  const size_t num_threads = min((size_t)max(physics_threads(), 1), count);
+  if (num_threads <= 1)
+  {
+    for (size_t i = 0; i < count; i++) block(i);
+    return;
+  }
+  
+  //// start the workers the first time, or again if the number of threads
+  //// changed
+  const size_t num_workers = (size_t)physics_threads() - 1;
+  if (_workers.size() != num_workers)
+  {
+    _stopWorkers();
+    for (size_t i = 1; i <= num_workers; i++)
+    {
+      _workers.emplace_back(&Core::_runWorker, this, i, _work_generation);
+    }
+  }
+  
+  //// hand the work to the workers, do the first range here, and wait for
+  //// the others to finish theirs
+  {
+    lock_guard<mutex> lock(_work_mutex);
+    _work = &block;
+    _work_count = count;
+    _work_threads = num_threads;
+    _work_pending = _workers.size();
+    _work_generation += 1;
+  }
+  _work_ready.notify_all();
+  _runWork(0);
+  
+  unique_lock<mutex> lock(_work_mutex);
+  _work_done.wait(lock, [this] { return _work_pending == 0; });
+  _work = nullptr;
+}
+
+void Core::_runWorker(size_t index, unsigned generation)
+{
+  while (true)
+  {
+    {
+      unique_lock<mutex> lock(_work_mutex);
+      _work_ready.wait(lock, [this, generation]
+      {
+        return _stops_workers || _work_generation != generation;
+      });
+      if (_stops_workers) return;
+      
+      generation = _work_generation;
+    }
+    
+    _runWork(index);
+    
+    {
+      lock_guard<mutex> lock(_work_mutex);
+      _work_pending -= 1;
+    }
+    _work_done.notify_one();
+  }
+}
+
+void Core::_runWork(size_t index)
+{
+  // the work is split into contiguous ranges, one for each thread, where
+  // the threads beyond those needed have nothing to do
+  if (index >= _work_threads) return;
+  
+  const size_t begin = _work_count * index / _work_threads;
+  const size_t end = _work_count * (index + 1) / _work_threads;
+  for (size_t i = begin; i < end; i++) (*_work)(i);
 }
 
+void Core::_stopWorkers()
+{
+  {
+    lock_guard<mutex> lock(_work_mutex);
+    _stops_workers = true;
+  }
+  _work_ready.notify_all();
+  for (auto & worker : _workers) worker.join();
+  _workers.clear();
+  _stops_workers = false;
+}
+
+void Core::_solveContacts()
+{
+  if (_dynamic_contacts.empty()) return;
+  
+  // both bodies of a pair may have hit each other, but the pair is solved
+  // once, in tree order so that the results are the same every run
+  for (auto & contact : _dynamic_contacts)
+  {
+    if (contact.a->_body_index > contact.b->_body_index)
+    {
+      swap(contact.a, contact.b);
+      contact.normal = -contact.normal;
+    }
+  }
+  stable_sort(_dynamic_contacts.begin(),
+              _dynamic_contacts.end(),
+              [](const _DynamicContact & l, const _DynamicContact & r)
+  {
+    return l.a->_body_index < r.a->_body_index ||
+           (l.a == r.a && l.b->_body_index < r.b->_body_index);
+  });
+  auto same_pair = [](const _DynamicContact & l, const _DynamicContact & r)
+  {
+    return l.a == r.a && l.b == r.b;
+  };
+  _dynamic_contacts.erase(unique(_dynamic_contacts.begin(),
+                                 _dynamic_contacts.end(),
+                                 same_pair),
+                          _dynamic_contacts.end());
+  
+  //// solve each contact a few times over, since solving one contact may
+  //// disturb another
+  const bool is_fixed_point = fixed_point();
+  const int max_iterations = 4;
+  for (int iteration = 0; iteration < max_iterations; iteration++)
+  {
+    for (auto & contact : _dynamic_contacts)
+    {
+      if (is_fixed_point) _solveContactFixed(contact);
+      else                _solveContact(contact);
+    }
+  }
+  _dynamic_contacts.clear();
+}
+
+void Core::_solveContact(const _DynamicContact & contact)
+{
+  PhysicsComponent * body_a = contact.a;
+  PhysicsComponent * body_b = contact.b;
+  const Vector2 normal = contact.normal;
+  
+  const double inverse_mass_a = _inverseMass(body_a);
+  const double inverse_mass_b = _inverseMass(body_b);
+  const double inverse_mass = inverse_mass_a + inverse_mass_b;
+  if (inverse_mass == 0) return;
+  
+  Entity * a = body_a->entity();
+  Entity * b = body_b->entity();
+  
+  Vector2 position_a, position_b;
+  a->calculateWorldPosition(position_a);
+  b->calculateWorldPosition(position_b);
+  const double depth =
+    _penetration(make_aabb(position_a, body_a->collision_bounds()),
+                 make_aabb(position_b, body_b->collision_bounds()),
+                 normal);
+  if (depth > 0)
+  {
+    const Vector2 push_a = normal * (depth * inverse_mass_a / inverse_mass);
+    const Vector2 push_b = normal * (depth * inverse_mass_b / inverse_mass);
+    a->moveBy(push_a.x, push_a.y);
+    b->moveBy(-push_b.x, -push_b.y);
+  }
+  
+  const Vector2 relative = a->velocity() - b->velocity();
+  const double approach = relative.x*normal.x + relative.y*normal.y;
+  if (approach < 0)
+  {
+    const double impulse = -approach / inverse_mass;
+    a->changeVelocityBy(normal.x * impulse * inverse_mass_a,
+                        normal.y * impulse * inverse_mass_a);
+    b->changeVelocityBy(-normal.x * impulse * inverse_mass_b,
+                        -normal.y * impulse * inverse_mass_b);
+  }
+}
+
+void Core::_solveContactFixed(const _DynamicContact & contact)
+{
+  PhysicsComponent * body_a = contact.a;
+  PhysicsComponent * body_b = contact.b;
+  
+  const Fixed inverse_mass_a = to_fixed(_inverseMass(body_a));
+  const Fixed inverse_mass_b = to_fixed(_inverseMass(body_b));
+  const Fixed inverse_mass = inverse_mass_a + inverse_mass_b;
+  if (inverse_mass == Fixed {0}) return;
+  
+  // the share of the response that a takes, which unlike the inverse masses
+  // cannot leave the fixed-point range, where b takes exactly the rest so
+  // that no overlap or approach is left over
+  const Fixed share_a = inverse_mass_a / inverse_mass;
+  
+  Entity * a = body_a->entity();
+  Entity * b = body_b->entity();
+  const FixedVector2 fixed_normal = to_fixed(contact.normal);
+  
+  // both boxes are placed relative to a
+  Vector2 position_a, position_b;
+  a->calculateWorldPosition(position_a);
+  b->calculateWorldPosition(position_b);
+  const AABB bounds_a = make_aabb(position_a, body_a->collision_bounds());
+  const AABB bounds_b = make_aabb(position_b, body_b->collision_bounds());
+  const Fixed depth = _penetration(to_fixed(bounds_a, bounds_a.min),
+                                   to_fixed(bounds_b, bounds_a.min),
+                                   fixed_normal);
+  if (depth > Fixed {0})
+  {
+    const Fixed depth_a = depth * share_a;
+    const Vector2 push_a = to_vector2(fixed_normal * depth_a);
+    const Vector2 push_b = to_vector2(fixed_normal * (depth - depth_a));
+    a->moveBy(push_a.x, push_a.y);
+    b->moveBy(-push_b.x, -push_b.y);
+  }
+  
+  const FixedVector2 relative = to_fixed(a->velocity()) -
+                                to_fixed(b->velocity());
+  const Fixed approach = relative.x*fixed_normal.x + relative.y*fixed_normal.y;
+  if (approach < Fixed {0})
+  {
+    const Fixed impulse_a = -approach * share_a;
+    const Vector2 change_a = to_vector2(fixed_normal * impulse_a);
+    const Vector2 change_b = to_vector2(fixed_normal * (approach + impulse_a));
+    a->changeVelocityBy(change_a.x, change_a.y);
+    b->changeVelocityBy(change_b.x, change_b.y);
+  }
+}
 
 //
 // MARK: - PhysicsComponent
@@ -304,55 +1091,150 @@ string PhysicsComponent::trait() { return "physics"; }
 // MARK: Member functions
 
 PhysicsComponent::PhysicsComponent()
-  : collision_bounds({0, 0, 16, 16})
+  : _idle_time(0)
+  , _was_enabled(true)
+  , _change_stamp(0)
+  , _staged(false)
+  , _broadphase(nullptr)
+  , _proxy(NULL_PROXY)
+  , _compound(nullptr)
+  , _body_stamp(0)
+  , _body_index(0)
+  , collision_bounds({0, 0, 16, 16})
   , gravity({0.0, 9.82})
   , dynamic(false)
   , collision_detection(false)
   , collision_response(false)
+  , friction(0)
+  , mass(1)
+  , layer(DEFAULT_LAYER)
+  , collides_with(ALL_LAYERS)
+  , responds_to(ALL_LAYERS)
+  , sleeping(false)
+  , can_sleep(true)
+  , continuous(false)
+  , max_substeps(8)
+  , trigger(false)
 {}
 
+PhysicsComponent::~PhysicsComponent()
+{
+  if (entity() && entity()->core()) entity()->core()->_removeBody(this);
+}
+
 void PhysicsComponent::init(Entity * entity)
 {
   Component::init(entity);
   
   _should_simulate = true;
-  _out_of_view = true;
   _did_collide = false;
+  _did_move = false;
   
-  auto did_start_animating = [this](Event) { _should_simulate = false; };
-  auto did_stop_animating = [this](Event) { _should_simulate = true;  };
+  auto did_start_animating = [this](Event)
+  {
+    _should_simulate = false;
+    wake();
+  };
+  auto did_stop_animating = [this](Event) { _should_simulate = true; };
   
+  // without a sender to observe, every animation would be observed
   auto animation = entity->animation();
-  NotificationCenter::observe(did_start_animating,
-                              DidStartAnimating,
-                              animation);
-  NotificationCenter::observe(did_stop_animating,
-                              DidStopAnimating,
-                              animation);
+  if (animation)
+  {
+    NotificationCenter::observe(did_start_animating,
+                                DidStartAnimating,
+                                animation);
+    NotificationCenter::observe(did_stop_animating,
+                                DidStopAnimating,
+                                animation);
+  }
+}
+
+void PhysicsComponent::reset()
+{
+  Component::reset();
+  wake();
 }
 
 void PhysicsComponent::update(Core & core)
 {
+  if (sleeping())
+  {
+    collided_entities().clear();
+    return;
+  }
+  
+  if (trigger())
+  {
+    _updateTrigger(core);
+    return;
+  }
   
-  // if simulating a dynamic entity, update its velocity
   Vector2 distance {};
   bool should_move = _should_simulate && dynamic();
-  if (should_move)
+  collided_entities().clear();
+  
+  // the staged results only hold while nothing has moved the body or changed
+  // its velocity since the start of the phase, such as an observer of an
+  // earlier collision
+  Vector2 position;
+  if (_staged) entity()->calculateWorldPosition(position);
+  const Vector2 start_velocity = entity()->velocity();
+  const bool is_staged =
+    _staged && should_move == _staged_should_move &&
+    position.x == _staged_start_position.x &&
+    position.y == _staged_start_position.y &&
+    start_velocity.x == _staged_start_velocity.x &&
+    start_velocity.y == _staged_start_velocity.y;
+  _staged = false;
+  if (is_staged)
   {
-    const auto velocity = gravity() * core.delta_time() * pixels_per_meter;
-    entity()->changeVelocityBy(velocity.x, velocity.y);
-    distance = entity()->velocity() * core.delta_time();
+    distance = _staged_distance;
+    entity()->changeVelocityTo(_staged_velocity.x, _staged_velocity.y);
+    collided_entities().swap(_staged_collisions);
+    for (auto entity : collided_entities()) entity->physics()->wake();
+    core._dynamic_contacts.insert(core._dynamic_contacts.end(),
+                                  _staged_contacts.begin(),
+                                  _staged_contacts.end());
+  }
+  else
+  {
+    const int num_steps = should_move ? _numSteps(core) : 1;
+    const double step_time = core.delta_time() / num_steps;
+    for (int step = 0; step < num_steps; step++)
+    {
+      // if simulating a dynamic entity, update its velocity
+      if (should_move)
+      {
+        Vector2 velocity = entity()->velocity();
+        _integrate(core, step_time, velocity, distance);
+        entity()->changeVelocityTo(velocity.x, velocity.y);
+      }
+      
+      // continuous bodies are swept once across all steps
+      const bool is_last_step = step == num_steps - 1;
+      if (continuous() && !is_last_step) continue;
+      
+      // if enabled, perform collision detection and response
+      if (collision_detection())
+      {
+        core.resolveCollisions(*entity(),
+                               distance,
+                               should_move && collision_response(),
+                               collided_entities());
+      }
+      
+      // the last step is moved below
+      if (!is_last_step)
+      {
+        entity()->moveBy(distance.x, distance.y);
+        distance = {0, 0};
+      }
+    }
   }
   
-  // if enabled, perform collision detection and response
-  collided_entities().clear();
   if (collision_detection())
   {
-    core.resolveCollisions(*entity(),
-                           distance,
-                           should_move && collision_response(),
-                           collided_entities());
-    
     // notify observers if at least one collision ocurred
     if (collided_entities().size() > 0)
     {
@@ -365,33 +1247,178 @@ void PhysicsComponent::update(Core & core)
     else _did_collide = false;
     
   }
+  _findTriggers(core, distance);
+  const bool did_change_contacts = _updateContacts();
   
   // if simulating a dynamic entity, update its position
   if (should_move)
   {
     entity()->moveBy(distance.x, distance.y);
+    _did_move = true;
+    _swept_bounds = sweep(_world_bounds, distance);
   }
   
-  // calculate if the entity has gone out of or into view
-  Vector2 world_position;
-  Dimension2 dimensions = entity()->dimensions();
-  entity()->calculateWorldPosition(world_position);
-  if (!_out_of_view &&
-      (world_position.x + dimensions.x < 0 ||
-       world_position.y + dimensions.y < 0 ||
-       world_position.x >= core.view_dimensions().x ||
-       world_position.y >= core.view_dimensions().y))
+  // keep the broadphase up to date for the bodies updated after this one
+  if (should_move && _proxy != NULL_PROXY)
   {
-    _out_of_view = true;
-    NotificationCenter::notify(DidMoveOutOfView, *this);
+    Vector2 world_position;
+    entity()->calculateWorldPosition(world_position);
+    _world_bounds = make_aabb(world_position, collision_bounds());
+    _broadphase->update(_proxy, _world_bounds);
+    if (_compound) _compound->bounds = merge(_compound->bounds, _world_bounds);
   }
-  else if (_out_of_view &&
-           world_position.x + dimensions.x >= 0 &&
-           world_position.y + dimensions.y >= 0 &&
-           world_position.x < core.view_dimensions().x &&
-           world_position.y < core.view_dimensions().y)
+  
+  // fall asleep after having been idle for a while
+  const Vector2 velocity = entity()->velocity();
+  if (can_sleep() && _should_simulate && !did_change_contacts &&
+      velocity.x*velocity.x + velocity.y*velocity.y <= sleep_speed*sleep_speed)
+  {
+    _idle_time += core.delta_time();
+    if (_idle_time >= sleep_delay) sleeping() = true;
+  }
+  else
   {
-    _out_of_view = false;
-    NotificationCenter::notify(DidMoveIntoView, *this);
+    _idle_time = 0;
+  }
+}
+
+void PhysicsComponent::wake()
+{
+  if (sleeping())
+  {
+    sleeping() = false;
+    _idle_time = 0;
+  }
+}
+
+// MARK: Private member functions
+
+int PhysicsComponent::_numSteps(Core & core)
+{
+  if (core.physics_step() <= 0) return 1;
+  
+  const int num_steps = (int)ceil(core.delta_time() / core.physics_step());
+  return max(1, min(num_steps, max_substeps()));
+}
+
+void PhysicsComponent::_integrate(Core & core,
+                                  double step_time,
+                                  Vector2 & velocity,
+                                  Vector2 & distance)
+{
+  if (core.fixed_point())
+  {
+    const Fixed dt = to_fixed(step_time);
+    const FixedVector2 dv = to_fixed(gravity() * pixels_per_meter) * dt;
+    FixedVector2 v = to_fixed(velocity);
+    FixedVector2 d = to_fixed(distance);
+    if (core.integrator() == VELOCITY_VERLET)
+    {
+      d += (v + dv * Fixed {FIXED_ONE / 2}) * dt;
+      v += dv;
+    }
+    else
+    {
+      v += dv;
+      d += v * dt;
+    }
+    velocity = to_vector2(v);
+    distance = to_vector2(d);
+    return;
+  }
+  
+  integrate(velocity,
+            distance,
+            gravity() * step_time * pixels_per_meter,
+            step_time,
+            core.integrator());
+}
+
+bool PhysicsComponent::_updateContacts()
+{
+  //// diff the entities touched now against those touched before, both sorted
+  _touched = collided_entities();
+  _touched.insert(_touched.end(), _overlapping.begin(), _overlapping.end());
+  sort(_touched.begin(), _touched.end());
+  
+  contacts().clear();
+  bool did_enter = false;
+  bool did_exit = false;
+  size_t i = 0;
+  size_t j = 0;
+  while (i < _touched.size() || j < _touching.size())
+  {
+    if (j == _touching.size() ||
+        (i < _touched.size() && _touched[i] < _touching[j]))
+    {
+      contacts().push_back({_touched[i++], Contact::ENTER});
+      did_enter = true;
+    }
+    else if (i == _touched.size() || _touching[j] < _touched[i])
+    {
+      contacts().push_back({_touching[j++], Contact::EXIT});
+      did_exit = true;
+    }
+    else
+    {
+      contacts().push_back({_touched[i++], Contact::STAY});
+      j++;
+    }
+  }
+  _touching.swap(_touched);
+  
+  if (did_enter) NotificationCenter::notify(DidStartColliding, *this);
+  if (did_exit)  NotificationCenter::notify(DidStopColliding, *this);
+  return did_enter || did_exit;
+}
+
+void PhysicsComponent::_updateTrigger(Core & core)
+{
+  //// find the bodies that overlap the trigger, without sweeping them
+  collided_entities().clear();
+  _overlapping.clear();
+  if (collision_detection() && _proxy != NULL_PROXY)
+  {
+    core._queryBodies(_world_bounds, collides_with(), _overlaps);
+    for (auto body : _overlaps)
+    {
+      _overlapping.push_back(((PhysicsComponent*)body)->entity());
+    }
+  }
+  const bool did_change_contacts = _updateContacts();
+  
+  // fall asleep after having overlapped nothing for a while
+  if (can_sleep() && !did_change_contacts && _touching.empty())
+  {
+    _idle_time += core.delta_time();
+    if (_idle_time >= sleep_delay) sleeping() = true;
+  }
+  else
+  {
+    _idle_time = 0;
+  }
+}
+
+void PhysicsComponent::_findTriggers(Core & core, Vector2 travel_distance)
+{
+  _overlapping.clear();
+  if (core._num_triggers == 0) return;
+  
+  // the area swept is searched, so that triggers passed through within a
+  // single frame are found as well
+  Vector2 position;
+  entity()->calculateWorldPosition(position);
+  const AABB area = sweep(make_aabb(position, collision_bounds()),
+                          travel_distance);
+  _overlaps.clear();
+  core._trigger_broadphase->query(area, ALL_LAYERS, _overlaps);
+  for (auto candidate : _overlaps)
+  {
+    PhysicsComponent * trigger = (PhysicsComponent*)candidate;
+    if (trigger->collides_with() & layer()) trigger->wake();
+    if (collision_detection() && (collides_with() & trigger->layer()))
+    {
+      _overlapping.push_back(trigger->entity());
+    }
   }
 }
@@ -6,6 +6,9 @@
 #pragma once
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <cmath>
 #include <string>
 
 #ifdef __APPLE__
@@ -150,6 +153,104 @@ inline Vector2 operator/=(Vector2 & l, Vector2 r) { return l = l / r; }
 inline Vector2 operator/=(Vector2 & l, double  c) { return l = l / c; }
 
 
+/**
+ *  Defines a signed 16.16 fixed-point number, in the range [-32768, 32768).
+ *  Fixed-point arithmetic is done on integers, so unlike floating-point
+ *  arithmetic it gives the same results on every machine and with any compiler
+ *  flags. Every fixed-point number converts to a double exactly.
+ */
+struct Fixed
+{
+  int32_t raw;
+};
+
+const int32_t FIXED_ONE = 1 << 16;
+
+/**
+ *  Rounds a number to the nearest fixed-point number, clamped to the range.
+ */
+inline Fixed to_fixed(double v)
+{
+  const double raw = floor(v * FIXED_ONE + 0.5);
+  if (raw >= INT32_MAX) return {INT32_MAX};
+  if (raw <= INT32_MIN) return {INT32_MIN};
+  return {(int32_t)raw};
+}
+
+inline double to_double(Fixed f) { return f.raw * (1.0 / FIXED_ONE); }
+
+inline Fixed operator+ (Fixed   l, Fixed r) { return {l.raw + r.raw}; }
+inline Fixed operator- (Fixed   v)          { return {-v.raw}; }
+inline Fixed operator- (Fixed   l, Fixed r) { return {l.raw - r.raw}; }
+inline Fixed operator+=(Fixed & l, Fixed r) { return l = l + r; }
+inline Fixed operator-=(Fixed & l, Fixed r) { return l = l - r; }
+
+inline bool operator==(Fixed l, Fixed r) { return l.raw == r.raw; }
+inline bool operator!=(Fixed l, Fixed r) { return l.raw != r.raw; }
+inline bool operator< (Fixed l, Fixed r) { return l.raw <  r.raw; }
+inline bool operator> (Fixed l, Fixed r) { return l.raw >  r.raw; }
+inline bool operator<=(Fixed l, Fixed r) { return l.raw <= r.raw; }
+inline bool operator>=(Fixed l, Fixed r) { return l.raw >= r.raw; }
+
+inline Fixed operator* (Fixed l, Fixed r)
+{
+  return {(int32_t)(((int64_t)l.raw * r.raw) >> 16)};
+}
+
+/**
+ *  Divides two fixed-point numbers, where the divisor must not be zero and
+ *  the quotient must lie within the range.
+ */
+inline Fixed operator/ (Fixed l, Fixed r)
+{
+  assert(r.raw != 0);
+  return {(int32_t)(((int64_t)l.raw << 16) / r.raw)};
+}
+
+/**
+ *  Defines a two-dimensional vector of fixed-point numbers.
+ */
+struct FixedVector2
+{
+  Fixed x, y;
+};
+
+inline FixedVector2 to_fixed(Vector2 v)
+{
+  return {to_fixed(v.x), to_fixed(v.y)};
+}
+
+inline Vector2 to_vector2(FixedVector2 v)
+{
+  return {to_double(v.x), to_double(v.y)};
+}
+
+/**
+ *  @return The vector rounded to the nearest fixed-point numbers.
+ */
+inline Vector2 round_to_fixed(Vector2 v) { return to_vector2(to_fixed(v)); }
+
+inline FixedVector2 operator+ (FixedVector2 l, FixedVector2 r)
+{
+  return {l.x + r.x, l.y + r.y};
+}
+
+inline FixedVector2 operator- (FixedVector2 l, FixedVector2 r)
+{
+  return {l.x - r.x, l.y - r.y};
+}
+
+inline FixedVector2 operator* (FixedVector2 l, Fixed c)
+{
+  return {l.x * c, l.y * c};
+}
+
+inline FixedVector2 operator+=(FixedVector2 & l, FixedVector2 r)
+{
+  return l = l + r;
+}
+
+
 /**
  *  Defines two dimensions by width and height.
  */
@@ -17,6 +17,8 @@ BlockPhysicsComponent::BlockPhysicsComponent()
   : PhysicsComponent()
 {
   collision_bounds({10, 8, 12, 12});
+  layer(BLOCK_LAYER);
+  collides_with(NO_LAYERS);
 }
 
 
@@ -171,6 +173,13 @@ void Board::init(Core * core)
   const Dimension2 view_dimensions = core->view_dimensions();
   moveTo((view_dimensions.x-BOARD_DIMENSIONS.x)/2,
          view_dimensions.y-BOARD_DIMENSIONS.y-16);
+  
+  // keep the blocks in a grid laid out like the pyramid, where each row is
+  // shifted half a block to the left of the one above it
+  Vector2 position;
+  calculateWorldPosition(position);
+  const Vector2 origin {position.x + BOARD_DIMENSIONS.x/2 - 16, position.y};
+  core->useBroadphase(new TileGrid(origin, {-16, 24}, 32), BLOCK_LAYER);
 }
 
 void Board::reset()
@@ -9,6 +9,9 @@
 
 const Dimension2 BOARD_DIMENSIONS { 224, 176 };
 
+// MARK: Collision layers
+const CollisionLayer BLOCK_LAYER = 1 << 1;
+
 
 // MARK: Events
 const Event DidClearBoard("DidClearBoard");
@@ -116,17 +116,20 @@ void CharacterAnimationComponent::init(Entity * entity)
 {
   AnimationComponent::init(entity);
   
+  // characters of the same kind jump along the same curves, which the curve
+  // library keeps a single copy of
   Vector2 gravity = entity->physics()->gravity();
   string ids[4] {"jump_up", "jump_down", "jump_left", "jump_right"};
   for (auto i = 0; i < 4; i++)
   {
     auto end_point = end_points()[i];
-    auto id = ids[i];
+    _jump_curves[i] = NULL_CURVE;
     if (end_point.x != 0 || end_point.y != 0)
     {
       auto spline = calculate_spline(end_point, animation_speed(), gravity);
-      addSegment(id, spline.first.first,  spline.first.second);
-      addSegment(id, spline.second.first, spline.second.second);
+      _jump_curves[i] = CurveLibrary::main().add({spline.first,
+                                                  spline.second});
+      addCurve(ids[i], _jump_curves[i]);
     }
   }
     
@@ -135,16 +138,16 @@ void CharacterAnimationComponent::init(Entity * entity)
     switch (event.parameter())
     {
       case UP:
-        performAnimation("jump_up", animation_speed(), true);
+        performAnimation(_jump_curves[0], animation_speed(), true);
         break;
       case DOWN:
-        performAnimation("jump_down", animation_speed(), true);
+        performAnimation(_jump_curves[1], animation_speed(), true);
         break;
       case LEFT:
-        performAnimation("jump_left", animation_speed(), true);
+        performAnimation(_jump_curves[2], animation_speed(), true);
         break;
       case RIGHT:
-        performAnimation("jump_right", animation_speed(), true);
+        performAnimation(_jump_curves[3], animation_speed(), true);
         break;
     }
   };
@@ -169,6 +172,15 @@ void CharacterAnimationComponent::reset()
 
 // MARK: Member functions
 
+CharacterPhysicsComponent::CharacterPhysicsComponent()
+  : PhysicsComponent()
+{
+  // characters detect each other, but are only blocked by the board
+  collides_with(BLOCK_LAYER | PLAYER_LAYER | ENEMY_LAYER);
+  responds_to(BLOCK_LAYER);
+  friction(1);
+}
+
 void CharacterPhysicsComponent::init(Entity * entity)
 {
   PhysicsComponent::init(entity);
@@ -212,17 +224,20 @@ void CharacterPhysicsComponent::update(Core & core)
 {
   PhysicsComponent::update(core);
   
-  for (auto collided_entity : collided_entities())
+  // only react when first touching an entity, and not while touching it
+  for (auto & contact : contacts())
   {
-    string id = collided_entity->id();
-    if (id.compare(0, 5, "block") == 0)
+    if (contact.phase != Contact::ENTER) continue;
+    
+    const CollisionLayer layer = contact.entity->physics()->layer();
+    if (layer & BLOCK_LAYER)
     {
       NotificationCenter::notify(DidCollideWithBlock, *this);
-      collision_with_block(((Block*)collided_entity));
+      collision_with_block(((Block*)contact.entity));
       continue;
     }
     
-    collision_with_entity(collided_entity);
+    collision_with_entity(contact.entity, layer);
   }
 }
 
@@ -237,23 +252,17 @@ void CharacterGraphicsComponent::init(Entity * entity)
 {
   GraphicsComponent::init(entity);
   
-  Character * character = (Character*)entity;
-  
-  auto did_jump = [this, character](Event event)
+  auto did_jump = [this](Event event)
   {
     _current_direction = event.parameter();
     _jumping = true;
-    const string prefix_jumping  = character->prefix_jumping();
-    const string id = prefix_jumping + "_" + to_string(_current_direction);
-    current_sprite(SpriteCollection::main().retrieve(id));
+    current_sprite(_jumping_sprites[_current_direction]);
   };
   
-  auto did_stop_animating = [this, character](Event)
+  auto did_stop_animating = [this](Event)
   {
     _jumping = false;
-    const string prefix_standing = character->prefix_standing();
-    const string id = prefix_standing + "_" + to_string(_current_direction);
-    current_sprite(SpriteCollection::main().retrieve(id));
+    current_sprite(_standing_sprites[_current_direction]);
   };
   
   auto input     = entity->input();
@@ -268,12 +277,22 @@ void CharacterGraphicsComponent::reset()
 {
   GraphicsComponent::reset();
   
+  // retrieve the sprites for every direction up front, since they are
+  // changed with every jump
+  const auto character = (Character*)entity();
+  SpriteCollection & sprites = SpriteCollection::main();
+  for (auto direction = 0; direction < 4; direction++)
+  {
+    const string direction_string = "_" + to_string(direction);
+    _standing_sprites[direction] =
+      sprites.retrieve(character->prefix_standing() + direction_string);
+    _jumping_sprites[direction] =
+      sprites.retrieve(character->prefix_jumping() + direction_string);
+  }
+  
   _current_direction = DOWN;
   _jumping = false;
-  const auto character = (Character*)entity();
-  const string direction_string = "_" + to_string(character->direction());
-  const string sprite_id = character->prefix_standing() + direction_string;
-  current_sprite(SpriteCollection::main().retrieve(sprite_id));
+  current_sprite(_standing_sprites[character->direction()]);
 }
 
 
@@ -320,6 +339,6 @@ void Character::init(Core * core)
   };
   
   NotificationCenter::observe(reset_to_default, DidClearBoard);
-  NotificationCenter::observe(reset_to_default, DidMoveOutOfView, physics());
+  NotificationCenter::observe(reset_to_default, DidMoveOutOfView, this);
   NotificationCenter::observe(reset_to_default, DidDie);
 }
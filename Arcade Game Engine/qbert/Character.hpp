@@ -14,6 +14,10 @@ const Event DidJumpOff("DidJumpOff");
 const Event DidCollideWithBlock("DidCollideWithBlock");
 const Event DidCollideWithEnemy("DidCollideWithEnemy");
 
+// Collision layers
+const CollisionLayer PLAYER_LAYER = 1 << 2;
+const CollisionLayer ENEMY_LAYER  = 1 << 3;
+
 
 //
 // MARK: - CharacterDirection
@@ -56,6 +60,7 @@ class CharacterAnimationComponent
   : public AnimationComponent
 {
   bool _did_jump_off;
+  CurveHandle _jump_curves[4];
 protected:
   virtual vector<Vector2> end_points() = 0;
   virtual double animation_speed() = 0;
@@ -75,9 +80,10 @@ class CharacterPhysicsComponent
   bool _animating;
   bool _has_jumped_once;
 protected:
-  virtual void collision_with_block(Block * block) {};
-  virtual void collision_with_entity(Entity * entity) {};
+  virtual void collision_with_block(Block *) {}
+  virtual void collision_with_entity(Entity *, CollisionLayer) {}
 public:
+  CharacterPhysicsComponent();
   virtual void init(Entity * entity);
   virtual void reset();
   void update(Core & core);
@@ -100,6 +106,8 @@ class CharacterGraphicsComponent
 {
   int _current_direction;
   bool _jumping;
+  Sprite * _standing_sprites[4];
+  Sprite * _jumping_sprites[4];
 protected:
 public:
   virtual void init(Entity * entity);
@@ -41,21 +41,14 @@ void PlayerTextGraphicsComponent::reset()
 {
   GraphicsComponent::reset();
   
-  _start_time = entity()->core()->elapsedTime();
-  _current_sprite_index = 0;
-}
-
-void PlayerTextGraphicsComponent::update(Core & core)
-{
-  auto elapsed = core.elapsedTime() - _start_time;
-  double cycles;
-  modf(elapsed/_duration, &cycles);
-  _start_time = _start_time + cycles * _duration;
-  _current_sprite_index = (int)floor(fmod(elapsed, _duration) / _duration * 6);
-  string id = "player_1_text_" + to_string(_current_sprite_index);
-  current_sprite(SpriteCollection::main().retrieve(id));
-  
-  GraphicsComponent::update(core);
+  _flipbook.frames.clear();
+  for (auto i = 0; i < 6; i++)
+  {
+    string id = "player_1_text_" + to_string(i);
+    _flipbook.frames.push_back(SpriteCollection::main().retrieve(id));
+  }
+  _flipbook.duration = 0.5;
+  playFlipbook(&_flipbook);
 }
 
 //
@@ -97,13 +90,23 @@ void ScoreDigitGraphicsComponent::init(Entity * entity)
   resizeTo(8, 16);
 }
 
+void ScoreDigitGraphicsComponent::reset()
+{
+  GraphicsComponent::reset();
+  
+  for (auto n = 0; n < 10; n++)
+  {
+    string id = "score_digit_" + to_string(n);
+    _digit_sprites[n] = SpriteCollection::main().retrieve(id);
+  }
+}
+
 void ScoreDigitGraphicsComponent::update(Core & core)
 {
   int digit = ((ScoreDigit*)entity())->digit();
   if (digit >= 0 && digit <= 9)
   {
-    string id = "score_digit_" + to_string(digit);
-    current_sprite(SpriteCollection::main().retrieve(id));
+    current_sprite(_digit_sprites[digit]);
   }
   else
   {
@@ -328,9 +331,9 @@ void HUD::init(Core * core)
     
   };
   
-  auto player_physics = core->root()->findChild("player")->physics();
-  NotificationCenter::observe(did_die, DidMoveOutOfView, player_physics);
-  NotificationCenter::observe(did_die, DidCollideWithEnemy, player_physics);
+  auto player = core->root()->findChild("player");
+  NotificationCenter::observe(did_die, DidMoveOutOfView, player);
+  NotificationCenter::observe(did_die, DidCollideWithEnemy, player->physics());
   
   moveTo(8, 8);
 }
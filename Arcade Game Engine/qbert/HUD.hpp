@@ -23,13 +23,10 @@ const Event DidDie("DidDie");
 class PlayerTextGraphicsComponent
   : public GraphicsComponent
 {
-  const double _duration = 0.5;
-  double _start_time;
-  int _current_sprite_index;
+  Flipbook _flipbook;
 public:
   void init(Entity * entity);
   void reset();
-  void update(Core & core);
 };
 
 
@@ -52,8 +49,10 @@ public:
 class ScoreDigitGraphicsComponent
   : public GraphicsComponent
 {
+  Sprite * _digit_sprites[10];
 public:
   void init(Entity * entity);
+  void reset();
   void update(Core & core);
 };
 
@@ -161,6 +161,7 @@ PlayerPhysicsComponent::PlayerPhysicsComponent()
   : CharacterPhysicsComponent()
 {
   collision_bounds({7, 4, 2, 12});
+  layer(PLAYER_LAYER);
 }
 
 void PlayerPhysicsComponent::init(Entity * entity)
@@ -173,7 +174,7 @@ void PlayerPhysicsComponent::init(Entity * entity)
     entity->core()->reset(1.5);
   };
   
-  NotificationCenter::observe(did_move_out_of_view, DidMoveOutOfView, this);
+  NotificationCenter::observe(did_move_out_of_view, DidMoveOutOfView, entity);
 }
 
 void PlayerPhysicsComponent::collision_with_block(Block * block)
@@ -181,10 +182,10 @@ void PlayerPhysicsComponent::collision_with_block(Block * block)
   block->touch();
 }
 
-void PlayerPhysicsComponent::collision_with_entity(Entity * entity)
+void PlayerPhysicsComponent::collision_with_entity(Entity * entity,
+                                                   CollisionLayer layer)
 {
-  string id = entity->id();
-  if (id.compare(0, 5, "enemy") == 0)
+  if (layer & ENEMY_LAYER)
   {
     NotificationCenter::notify(DidCollideWithEnemy, *this);
     entity->core()->pause();
@@ -216,9 +217,7 @@ void Player::init(Core * core)
   auto should_revert = [this](Event) { _should_revert = true; };
   
   NotificationCenter::observe(should_revert, DidClearBoard);
-  NotificationCenter::observe(should_revert,
-                              DidMoveOutOfView,
-                              physics());
+  NotificationCenter::observe(should_revert, DidMoveOutOfView, this);
   NotificationCenter::observe(should_revert, DidDie);
 }
 
@@ -49,7 +49,7 @@ class PlayerPhysicsComponent
 {
 protected:
   void collision_with_block(Block * block);
-  void collision_with_entity(Entity * entity);
+  void collision_with_entity(Entity * entity, CollisionLayer layer);
 public:
   PlayerPhysicsComponent();
   void init(Entity * entity);
@@ -65,6 +65,7 @@ UggPhysicsComponent::UggPhysicsComponent()
   : CharacterPhysicsComponent()
 {
   gravity({-1.417, -0.818});
+  layer(ENEMY_LAYER);
 }
 
 void UggPhysicsComponent::init(Entity * entity)
@@ -77,7 +78,7 @@ void UggPhysicsComponent::init(Entity * entity)
     entity->reset();
   };
   
-  NotificationCenter::observe(did_move_out_of_view, DidMoveOutOfView, this);
+  NotificationCenter::observe(did_move_out_of_view, DidMoveOutOfView, entity);
 }
 
 
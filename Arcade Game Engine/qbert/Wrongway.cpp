@@ -68,6 +68,7 @@ WrongwayPhysicsComponent::WrongwayPhysicsComponent()
   : CharacterPhysicsComponent()
 {
   gravity({1.417, -0.818});
+  layer(ENEMY_LAYER);
 }
 
 void WrongwayPhysicsComponent::init(Entity * entity)
@@ -80,7 +81,7 @@ void WrongwayPhysicsComponent::init(Entity * entity)
     entity->reset();
   };
   
-  NotificationCenter::observe(did_move_out_of_view, DidMoveOutOfView, this);
+  NotificationCenter::observe(did_move_out_of_view, DidMoveOutOfView, entity);
 }
 
 
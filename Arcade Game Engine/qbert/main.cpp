@@ -16,13 +16,23 @@ int main(int argc, char * argv[])
   Core core;
   Level level("level");
   
+  // profile the game into a file when given "--profile <file>"
+  const char * profile_path = nullptr;
+  for (int i = 1; i + 1 < argc; i++)
+  {
+    if (string(argv[i]) == "--profile") profile_path = argv[i + 1];
+  }
+  
   // initialize game world
   core.scale(scale);
+  Profiler::main().enabled(profile_path != nullptr);
   if (core.init(&level, "Q*bert", scaled_screen_size, {0x00, 0x00, 0x00, 0xFF}))
   {
     // game loop
     while (core.update());
     
+    if (profile_path) Profiler::main().exportJSON(profile_path);
+    
     // destroy game world
     core.destroy();
   }